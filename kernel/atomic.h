@@ -51,6 +51,12 @@ public:
     T fetch_add(T inc) {
         return __atomic_fetch_add(&value,inc,__ATOMIC_SEQ_CST);
     }
+    T fetch_or(T bits) {
+        return __atomic_fetch_or(&value,bits,__ATOMIC_SEQ_CST);
+    }
+    T fetch_and(T bits) {
+        return __atomic_fetch_and(&value,bits,__ATOMIC_SEQ_CST);
+    }
     T add_fetch(T inc) {
         return __atomic_add_fetch(&value,inc,__ATOMIC_SEQ_CST);
     }
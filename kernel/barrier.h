@@ -24,3 +24,29 @@ public:
         
 };
 
+
+// A barrier that can be synced over and over by the same "n" threads, e.g.
+// once per frame. Two turnstiles: nobody can get through the first one
+// again until everybody has left the second one.
+class ReusableBarrier {
+    const int32_t n;
+    Atomic<int32_t> inside{0};
+    Semaphore arrive{0};
+    Semaphore leave{0};
+public:
+    ReusableBarrier(int32_t const n): n(n) {
+    }
+    ReusableBarrier(ReusableBarrier const&) = delete;
+
+    void sync() {
+        if (inside.add_fetch(1) == n) {
+            for (int32_t i = 0; i < n; i++) arrive.up();
+        }
+        arrive.down();
+
+        if (inside.add_fetch(-1) == 0) {
+            for (int32_t i = 0; i < n; i++) leave.up();
+        }
+        leave.down();
+    }
+};
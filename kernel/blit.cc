@@ -0,0 +1,123 @@
+#include "blit.h"
+#include "machine.h"
+
+namespace {
+
+    // "S" copies of "color" starting at "p"
+    template <uint32_t S>
+    inline uint8_t* put_run(uint8_t* p, uint8_t color) {
+        if constexpr (S % 4 == 0) {
+            const uint32_t c4 = color * 0x01010101;
+            auto w = (uint32_t*) p;
+            for (uint32_t i = 0; i < S / 4; i++) {
+                w[i] = c4;
+            }
+        } else if constexpr (S == 2) {
+            *(uint16_t*) p = color * 0x0101;
+        } else {
+            for (uint32_t i = 0; i < S; i++) {
+                p[i] = color;
+            }
+        }
+        return p + S;
+    }
+
+    // "S" copies of each of the 4 colors at "c". That is 4 * S bytes, a
+    // whole number of words whatever S is, so every store is a word even
+    // when a run ends in the middle of one
+    template <uint32_t S>
+    inline uint8_t* put_runs4(uint8_t* p, const uint8_t* c) {
+        auto w = (uint32_t*) p;
+        for (uint32_t i = 0; i < S; i++) {
+            uint32_t word = 0;
+            for (uint32_t b = 0; b < 4; b++) {
+                word |= uint32_t(c[(4 * i + b) / S]) << (8 * b);
+            }
+            w[i] = word;
+        }
+        return p + 4 * S;
+    }
+
+    inline void copy_row(uint8_t* dst, const uint8_t* src, uint32_t bytes) {
+        memcpy32(dst, src, bytes / 4);
+        if (bytes % 4 != 0) {
+            memcpy(dst + (bytes & ~3), src + (bytes & ~3), bytes % 4);
+        }
+    }
+
+    // one destination row from one source row
+    template <BlitFormat F, uint32_t S>
+    inline void expand_row(const uint8_t* src, uint32_t width, uint8_t* dst, uint8_t black, uint8_t white) {
+        if constexpr (F == BLIT_8BPP) {
+            if constexpr (S == 1) {
+                copy_row(dst, src, width);
+            } else if constexpr (S % 4 == 0) {
+                for (uint32_t x = 0; x < width; x++) {
+                    dst = put_run<S>(dst, src[x]);
+                }
+            } else {
+                uint32_t x = 0;
+                for (; x + 4 <= width; x += 4) {
+                    dst = put_runs4<S>(dst, src + x);
+                }
+                for (; x < width; x++) {
+                    dst = put_run<S>(dst, src[x]);
+                }
+            }
+        } else {
+            for (uint32_t i = 0; i < width / 8; i++) {
+                const uint8_t bits = src[i];
+                if constexpr (S % 4 == 0) {
+                    for (uint32_t b = 0; b < 8; b++) {
+                        dst = put_run<S>(dst, (bits & (0x80 >> b)) ? white : black);
+                    }
+                } else {
+                    uint8_t colors[8];
+                    for (uint32_t b = 0; b < 8; b++) {
+                        colors[b] = (bits & (0x80 >> b)) ? white : black;
+                    }
+                    dst = put_runs4<S>(dst, colors);
+                    dst = put_runs4<S>(dst, colors + 4);
+                }
+            }
+        }
+    }
+
+    template <BlitFormat F, uint32_t S>
+    void blit(const uint8_t* src, uint32_t src_stride, uint32_t width, uint32_t height,
+              uint8_t* dst, uint32_t dst_stride, uint8_t black, uint8_t white) {
+        const uint32_t row_bytes = width * S;
+        for (uint32_t y = 0; y < height; y++) {
+            expand_row<F, S>(src, width, dst, black, white);
+            for (uint32_t j = 1; j < S; j++) {
+                copy_row(dst + j * dst_stride, dst, row_bytes);
+            }
+            src += src_stride;
+            dst += S * dst_stride;
+        }
+    }
+
+    constexpr uint32_t N_SCALES = sizeof(BLIT_SCALES) / sizeof(BLIT_SCALES[0]);
+
+    // indexed by [format][position of the scale in BLIT_SCALES]
+    const BlitKernel kernels[2][N_SCALES] = {
+        {
+            blit<BLIT_1BPP, 1>, blit<BLIT_1BPP, 2>, blit<BLIT_1BPP, 4>, blit<BLIT_1BPP, 5>,
+            blit<BLIT_1BPP, 8>, blit<BLIT_1BPP, 10>, blit<BLIT_1BPP, 20>, blit<BLIT_1BPP, 40>,
+        },
+        {
+            blit<BLIT_8BPP, 1>, blit<BLIT_8BPP, 2>, blit<BLIT_8BPP, 4>, blit<BLIT_8BPP, 5>,
+            blit<BLIT_8BPP, 8>, blit<BLIT_8BPP, 10>, blit<BLIT_8BPP, 20>, blit<BLIT_8BPP, 40>,
+        },
+    };
+
+    static_assert(N_SCALES == 8 && BLIT_SCALES[7] == 40, "update the kernel table");
+}
+
+BlitKernel blit_kernel(BlitFormat format, uint32_t scale) {
+    if (format != BLIT_1BPP && format != BLIT_8BPP) return nullptr;
+    for (uint32_t i = 0; i < N_SCALES; i++) {
+        if (BLIT_SCALES[i] == scale) return kernels[format][i];
+    }
+    return nullptr;
+}
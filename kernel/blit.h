@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+// Integer scale-and-blit kernels.
+//
+// Every (source format, scale) pair in BLIT_SCALES has its own
+// instantiation with the scale known at compile time. A kernel expands
+// each source row once into the first of its "scale" destination rows,
+// then copies that row down with memcpy32. Scales that are a multiple of
+// 4 write each pixel's run with word stores; the others expand 4 source
+// pixels at a time into "scale" words, so runs that share a word are
+// merged and the stores stay word-wide (and word aligned if "dst" is).
+// There is no per-pixel offset math or call, unlike plotting scale x
+// scale rectangles.
+//
+// The first destination row of each group is read back for the copies, so
+// "dst" should be RAM or a linear framebuffer, not planar VGA memory.
+
+enum BlitFormat : uint8_t {
+    BLIT_1BPP = 0,      // packed, MSB is the leftmost pixel, "width" is a multiple of 8
+    BLIT_8BPP = 1,      // one palette index per byte
+};
+
+constexpr uint32_t BLIT_SCALES[] = {1, 2, 4, 5, 8, 10, 20, 40};
+
+// Scale a "width" x "height" source (rows "src_stride" bytes apart) into
+// "dst" (rows "dst_stride" bytes apart). 1bpp sources use "black" and
+// "white" for 0 and 1 bits, 8bpp sources ignore them.
+typedef void (*BlitKernel)(const uint8_t* src, uint32_t src_stride, uint32_t width, uint32_t height,
+                           uint8_t* dst, uint32_t dst_stride, uint8_t black, uint8_t white);
+
+// The kernel for "format" at "scale", nullptr if "scale" is not one of
+// BLIT_SCALES
+extern BlitKernel blit_kernel(BlitFormat format, uint32_t scale);
@@ -0,0 +1,128 @@
+#include "clock.h"
+#include "config.h"
+#include "machine.h"
+#include "pit.h"
+#include "debug.h"
+
+namespace Clock {
+
+    // HPET registers, offsets from kConfig.hpet
+    constexpr uint32_t HPET_CAPABILITIES = 0x00;    // period in fs in the top half
+    constexpr uint32_t HPET_CONFIG = 0x10;
+    constexpr uint32_t HPET_COUNTER = 0xF0;
+    constexpr uint32_t HPET_ENABLE = 1 << 0;
+    constexpr uint32_t HPET_COUNT_64 = 1 << 13;     // the counter is 64 bits wide
+
+    constexpr uint64_t FS_PER_S = 1000000000000000ull;
+
+    // x / hz seconds, in "unit" per second, as (x * mult) >> shift
+    struct Scale {
+        uint32_t mult = 0;
+        uint32_t shift = 0;
+
+        // the largest shift (at most 32) that keeps mult in 32 bits
+        void set(uint64_t unit, uint64_t hz) {
+            shift = 32;
+            while (shift > 0 && ((unit << shift) / hz) >> 32 != 0) {
+                shift -= 1;
+            }
+            mult = uint32_t((unit << shift) / hz);
+        }
+
+        // 64 x 32 bit multiply split in two 32 x 32 ones so nothing
+        // overflows: x = hi * 2^32 + lo
+        uint64_t apply(uint64_t x) const {
+            const uint64_t hi = (x >> 32) * mult;
+            const uint64_t lo = (x & 0xFFFFFFFF) * mult;
+            return (hi << (32 - shift)) + (lo >> shift);
+        }
+    };
+
+    static Source src = JIFFIES;
+    static uint64_t hz = 0;
+    static uint64_t base = 0;       // the count at init()
+    static Scale to_ns;
+    static Scale to_us;
+
+    static inline volatile uint32_t& hpet_reg(uint32_t offset) {
+        return *(volatile uint32_t*) (kConfig.hpet + offset);
+    }
+
+    // the halves can't be read at once, read high, low, high until the
+    // high half holds still
+    static uint64_t hpet_count() {
+        uint32_t hi, lo;
+        do {
+            hi = hpet_reg(HPET_COUNTER + 4);
+            lo = hpet_reg(HPET_COUNTER);
+        } while (hi != hpet_reg(HPET_COUNTER + 4));
+        return (uint64_t(hi) << 32) | lo;
+    }
+
+    static inline uint64_t count() {
+        switch (src) {
+        case TSC:
+            return rdtsc();
+        case HPET:
+            return hpet_count();
+        default:
+            return Pit::jiffies;
+        }
+    }
+
+    static bool invariant_tsc() {
+        cpuid_out out;
+        cpuid(0x80000000, &out);
+        if (out.a < 0x80000007) return false;
+        cpuid(0x80000007, &out);
+        return (out.d & (1 << 8)) != 0;
+    }
+
+    // turn the HPET on, returns its rate (0 if it can't be used)
+    static uint64_t hpet_start() {
+        if (kConfig.hpet == 0) return 0;
+        const uint32_t caps = hpet_reg(HPET_CAPABILITIES);
+        const uint32_t period_fs = hpet_reg(HPET_CAPABILITIES + 4);
+        if ((caps & HPET_COUNT_64) == 0 || period_fs == 0) return 0;
+
+        hpet_reg(HPET_CONFIG) = hpet_reg(HPET_CONFIG) | HPET_ENABLE;
+        return FS_PER_S / period_fs;
+    }
+
+    void init(uint64_t tsc_hz) {
+        const uint64_t hpet_hz = hpet_start();
+
+        if (tsc_hz != 0 && (invariant_tsc() || hpet_hz == 0)) {
+            src = TSC;
+            hz = tsc_hz;
+        } else if (hpet_hz != 0) {
+            src = HPET;
+            hz = hpet_hz;
+        } else {
+            hz = Pit::secondsToJiffies(1);
+        }
+
+        to_ns.set(1000000000, hz);
+        to_us.set(1000000, hz);
+        base = count();
+
+        static const char* names[] = {"jiffies", "tsc", "hpet"};
+        Debug::printf("| clocksource %s at %d kHz\n", names[src], uint32_t(hz / 1000));
+    }
+
+    Source source() {
+        return src;
+    }
+
+    uint64_t frequency() {
+        return hz;
+    }
+
+    uint64_t now_ns() {
+        return to_ns.apply(count() - base);
+    }
+
+    uint64_t now_us() {
+        return to_us.apply(count() - base);
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// Monotonic high resolution time.
+//
+// Pit::jiffies only moves when core 0 takes a timer interrupt and only has
+// millisecond resolution. The clocksource reads a free running hardware
+// counter instead, so any core can read it at any time (interrupts on or
+// off) without locks:
+//
+//    TSC    the time stamp counter, its rate measured against the PIT
+//           during Pit::calibrate(). Used when CPUID says it is invariant
+//           (constant rate, keeps running in deep C-states) or when there
+//           is no HPET
+//    HPET   the main counter of the HPET (from the ACPI tables), its rate
+//           comes from the hardware. Only used with a 64 bit counter
+//
+// If neither works the time comes from Pit::jiffies. Before init() runs
+// the time is always 0.
+//
+// Counts are turned into time with a multiply and a shift (no division),
+// the parameters are written once by init() on the bootstrap core before
+// any other core starts and are read-only afterwards.
+namespace Clock {
+
+    enum Source { JIFFIES, TSC, HPET };
+
+    // pick a source, "tsc_hz" is the TSC rate Pit::calibrate() measured
+    extern void init(uint64_t tsc_hz);
+
+    extern Source source();
+
+    // the rate of the source in Hz
+    extern uint64_t frequency();
+
+    // time since init(), never goes backwards on one core
+    extern uint64_t now_ns();
+    extern uint64_t now_us();
+}
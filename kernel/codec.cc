@@ -0,0 +1,269 @@
+#include "codec.h"
+#include "machine.h"
+#include "libk.h"
+
+namespace {
+
+    // Reads LEB128 run lengths from a payload, remembering if we ran off
+    // the end so the decoders only need to check once per run
+    struct RunReader {
+        const uint8_t* p;
+        const uint8_t* const end;
+        bool ok = true;
+
+        RunReader(const uint8_t* data, uint32_t size): p(data), end(data + size) {}
+
+        bool done() { return p == end; }
+
+        uint32_t next() {
+            uint32_t v = 0;
+            uint32_t shift = 0;
+            while (true) {
+                if (p == end || shift > 28) {
+                    ok = false;
+                    return 0;
+                }
+                uint8_t b = *p++;
+                v |= uint32_t(b & 0x7F) << shift;
+                if ((b & 0x80) == 0) return v;
+                shift += 7;
+            }
+        }
+    };
+
+    // same idea as fill_run, but flips the pixels by XORing them with "mask"
+    inline void flip(uint8_t* p, uint32_t n, uint8_t mask) {
+        while (n > 0 && ((uintptr_t) p & 3) != 0) {
+            *p++ ^= mask;
+            n--;
+        }
+        const uint32_t mask4 = mask * 0x01010101;
+        auto w = (uint32_t*) p;
+        for (uint32_t i = 0; i < n / 4; i++) {
+            w[i] ^= mask4;
+        }
+        p += n & ~3;
+        n &= 3;
+        while (n > 0) {
+            *p++ ^= mask;
+            n--;
+        }
+    }
+
+    // Reads the 2 bit quadtree node codes
+    struct NodeReader {
+        const uint8_t* const data;
+        const uint32_t size;
+        uint32_t bit = 0;
+        bool ok = true;
+
+        NodeReader(const uint8_t* data, uint32_t size): data(data), size(size) {}
+
+        bool done() { return (bit + 7) / 8 == size; }
+
+        uint32_t next() {
+            if (bit + 2 > size * 8) {
+                ok = false;
+                return 0;
+            }
+            uint32_t v = (data[bit / 8] >> (6 - bit % 8)) & 3;
+            bit += 2;
+            return v;
+        }
+    };
+
+    // The rows a decoder is allowed to write, [y0, y1). Everything outside
+    // is still parsed (so malformed input is caught the same way) but left
+    // alone. A node, fill or run is counted in the stats only by the rows
+    // that hold its first pixel, so the stats of the bands of a frame add
+    // up to those of decoding it whole
+    struct Rows {
+        uint32_t y0;
+        uint32_t y1;
+    };
+
+    bool decode_quad(NodeReader& in, uint8_t* dst, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                     uint8_t black, uint8_t white, Rows rows, DecodeStats& stats) {
+        if (y >= rows.y0 && y < rows.y1) stats.nodes += 1;
+        auto code = in.next();
+        if (!in.ok) return false;
+
+        if (code == 0 || code == 1) {
+            // uniform node, one rectangle fill clipped to "rows"
+            auto color = (code == 0) ? black : white;
+            auto top = K::max(y, rows.y0);
+            auto bottom = K::min(y + h, rows.y1);
+            if (top >= bottom) return true;
+            for (uint32_t j = top; j < bottom; j++) {
+                fill_run(dst + j * VGA_WIDTH + x, w, color);
+            }
+            if (top == y) stats.fills += 1;
+            return true;
+        }
+        if (code != 2 || (w == 1 && h == 1)) return false;
+
+        const uint32_t w0 = w / 2;
+        const uint32_t h0 = h / 2;
+        const uint32_t w1 = w - w0;
+        const uint32_t h1 = h - h0;
+
+        if (h0 != 0) {
+            if (w0 != 0 && !decode_quad(in, dst, x, y, w0, h0, black, white, rows, stats)) return false;
+            if (!decode_quad(in, dst, x + w0, y, w1, h0, black, white, rows, stats)) return false;
+        }
+        if (w0 != 0 && !decode_quad(in, dst, x, y + h0, w0, h1, black, white, rows, stats)) return false;
+        return decode_quad(in, dst, x + w0, y + h0, w1, h1, black, white, rows, stats);
+    }
+
+    bool decode_rle_key(RunReader& in, uint8_t* dst, uint8_t black, uint8_t white, Rows rows, DecodeStats& stats) {
+        // rows after y1 are never looked at, the band that ends the frame
+        // is the one that checks for trailing garbage
+        for (uint32_t y = 0; y < rows.y1; y++) {
+            uint8_t* row = dst + y * VGA_WIDTH;
+            const bool draw = y >= rows.y0;
+            uint32_t x = 0;
+            bool is_white = false;
+            while (x < VGA_WIDTH) {
+                uint32_t n = in.next();
+                if (!in.ok || n > VGA_WIDTH - x) return false;
+                if (draw) {
+                    fill_run(row + x, n, is_white ? white : black);
+                    stats.fills += 1;
+                }
+                x += n;
+                is_white = !is_white;
+            }
+        }
+        return rows.y1 < VGA_HEIGHT || in.done();
+    }
+
+    bool decode_rle_delta(RunReader& in, uint8_t* dst, uint8_t black, uint8_t white, Rows rows, DecodeStats& stats) {
+        constexpr uint32_t PIXELS = VGA_WIDTH * VGA_HEIGHT;
+        const uint8_t mask = black ^ white;
+        const uint32_t first = rows.y0 * VGA_WIDTH;
+        const uint32_t last = rows.y1 * VGA_WIDTH;
+        uint32_t i = 0;
+        bool flipped = false;
+        while (i < last) {
+            uint32_t n = in.next();
+            if (!in.ok || n > PIXELS - i) return false;
+            if (flipped) {
+                // clip the run to [first, last)
+                auto from = K::max(i, first);
+                auto to = K::min(i + n, last);
+                if (from < to) {
+                    flip(dst + from, to - from, mask);
+                    if (from == i) stats.fills += 1;
+                }
+            }
+            i += n;
+            flipped = !flipped;
+        }
+        if (last < PIXELS) return true;
+        return in.done();
+    }
+
+    constexpr uint32_t DITHER_LEVELS = 16;
+
+    // 4x4 Bayer matrix, thresholds in sixteenths
+    constexpr uint8_t BAYER[4][4] = {
+        { 0,  8,  2, 10},
+        {12,  4, 14,  6},
+        { 3, 11,  1,  9},
+        {15,  7, 13,  5},
+    };
+
+    // gray level -> palette index, built at compile time
+    struct GrayTables {
+        uint8_t ramp[256];
+        uint8_t dithered[4][4][256];    // [y & 3][x & 3][gray]
+    };
+
+    constexpr GrayTables make_gray_tables() {
+        GrayTables t{};
+        constexpr uint32_t top = VGA_GRAY_LEVELS - 1;
+        for (uint32_t g = 0; g < 256; g++) {
+            t.ramp[g] = uint8_t(VGA_GRAY_BASE + (g * top + 127) / 255);
+            for (uint32_t y = 0; y < 4; y++) {
+                for (uint32_t x = 0; x < 4; x++) {
+                    // round up to the next of the 16 levels when the
+                    // remainder beats this position's threshold
+                    const uint32_t threshold = (BAYER[y][x] * 2 + 1) * 255 / 32;
+                    uint32_t level = (g * (DITHER_LEVELS - 1) + threshold) / 255;
+                    if (level > DITHER_LEVELS - 1) level = DITHER_LEVELS - 1;
+                    t.dithered[y][x][g] = uint8_t(VGA_GRAY_BASE + level * top / (DITHER_LEVELS - 1));
+                }
+            }
+        }
+        return t;
+    }
+
+    constexpr GrayTables gray_tables = make_gray_tables();
+
+    bool gray_dither = false;
+
+    // 4 pixels per iteration, one word store each (VGA_WIDTH is a
+    // multiple of 4 and rows start word aligned)
+    bool decode_gray(const uint8_t* data, uint8_t* dst, Rows rows, DecodeStats& stats) {
+        const bool dither = gray_dither;
+        for (uint32_t y = rows.y0; y < rows.y1; y++) {
+            auto src = data + y * VGA_WIDTH;
+            auto out = (uint32_t*) (dst + y * VGA_WIDTH);
+            if (dither) {
+                auto lut = gray_tables.dithered[y & 3];
+                for (uint32_t x = 0; x < VGA_WIDTH; x += 4) {
+                    out[x / 4] = lut[0][src[x]] | (lut[1][src[x + 1]] << 8) |
+                        (lut[2][src[x + 2]] << 16) | (uint32_t(lut[3][src[x + 3]]) << 24);
+                }
+            } else {
+                auto lut = gray_tables.ramp;
+                for (uint32_t x = 0; x < VGA_WIDTH; x += 4) {
+                    out[x / 4] = lut[src[x]] | (lut[src[x + 1]] << 8) |
+                        (lut[src[x + 2]] << 16) | (uint32_t(lut[src[x + 3]]) << 24);
+                }
+            }
+        }
+        stats.fills += rows.y1 - rows.y0;
+        return true;
+    }
+}
+
+void set_gray_dither(bool on) {
+    gray_dither = on;
+}
+
+bool decode_frame(uint16_t codec, const uint8_t* data, uint32_t size, uint8_t* dst, uint8_t black, uint8_t white, DecodeStats* stats) {
+    return decode_frame_rows(codec, data, size, dst, black, white, 0, VGA_HEIGHT, stats);
+}
+
+bool decode_frame_rows(uint16_t codec, const uint8_t* data, uint32_t size, uint8_t* dst, uint8_t black, uint8_t white,
+                       uint32_t y0, uint32_t y1, DecodeStats* stats) {
+    DecodeStats ignored{};
+    DecodeStats& out = (stats == nullptr) ? ignored : *stats;
+    if (y0 >= y1 || y1 > VGA_HEIGHT) return false;
+    const Rows rows{y0, y1};
+
+    switch (codec) {
+    case CODEC_RAW:
+        if (size != PACKED_FRAME_BYTES) return false;
+        expand_1bpp(data + y0 * PACKED_ROW_BYTES, dst + y0 * VGA_WIDTH, (y1 - y0) * PACKED_ROW_BYTES, black, white);
+        return true;
+    case CODEC_RLE_KEY: {
+        RunReader in{data, size};
+        return decode_rle_key(in, dst, black, white, rows, out);
+    }
+    case CODEC_RLE_DELTA: {
+        RunReader in{data, size};
+        return decode_rle_delta(in, dst, black, white, rows, out);
+    }
+    case CODEC_QUADTREE: {
+        NodeReader in{data, size};
+        return decode_quad(in, dst, 0, 0, VGA_WIDTH, VGA_HEIGHT, black, white, rows, out) && in.done();
+    }
+    case CODEC_GRAY_RAW:
+        if (size != GRAY_FRAME_BYTES) return false;
+        return decode_gray(data, dst, rows, out);
+    default:
+        return false;
+    }
+}
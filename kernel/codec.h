@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include "frame.h"
+
+// Black and white (and grayscale) frame codecs.
+//
+// Every frame is stored as a FrameRecord followed by "size" bytes of
+// payload. The payload depends on the codec:
+//
+//    CODEC_RAW        a PackedFrame (PACKED_FRAME_BYTES bytes)
+//
+//    CODEC_RLE_KEY    for each of the VGA_HEIGHT scanlines, run lengths
+//                     that alternate black, white, black, ... (always
+//                     starting with black, possibly with a 0 length run)
+//                     and add up to exactly VGA_WIDTH
+//
+//    CODEC_RLE_DELTA  the XOR of this frame and the previous one, as run
+//                     lengths over the whole frame (in raster order) that
+//                     alternate unchanged, flipped, unchanged, ... (always
+//                     starting with unchanged) and add up to exactly
+//                     VGA_WIDTH * VGA_HEIGHT
+//
+//    CODEC_QUADTREE   the frame as a quadtree, pre-order, 2 bits per node
+//                     packed most significant bits first (the last byte
+//                     is padded with zeros):
+//                         0 -> the whole node is black
+//                         1 -> the whole node is white
+//                         2 -> split, followed by the NW, NE, SW and SE
+//                              children
+//                     The root is the whole VGA_WIDTH x VGA_HEIGHT frame.
+//                     A w x h node splits at (w/2, h/2), children with no
+//                     pixels (when w or h is 1) are left out.
+//
+//    CODEC_GRAY_RAW   VGA_WIDTH * VGA_HEIGHT bytes of 8 bit gray levels
+//                     (0 black, 255 white), rows top to bottom. Decoding
+//                     maps them onto the VGA_GRAY_LEVELS ramp of the
+//                     palette, or with set_gray_dither() onto 16 of its
+//                     levels with 4x4 ordered dithering. The black and
+//                     white colors are not used
+//
+// Run lengths are unsigned LEB128: 7 bits per byte, least significant
+// group first, the top bit is set on every byte but the last.
+//
+// Encoders are expected to fall back to CODEC_RAW whenever the compressed
+// form would be bigger, so no black and white payload is larger than
+// PACKED_FRAME_BYTES and no payload at all is larger than
+// MAX_ENCODED_FRAME_BYTES.
+
+enum FrameCodec : uint16_t {
+    CODEC_RAW = 0,
+    CODEC_RLE_KEY = 1,
+    CODEC_RLE_DELTA = 2,
+    CODEC_QUADTREE = 3,
+    CODEC_GRAY_RAW = 4,
+};
+
+constexpr uint32_t GRAY_FRAME_BYTES = VGA_WIDTH * VGA_HEIGHT;
+constexpr uint32_t MAX_ENCODED_FRAME_BYTES = GRAY_FRAME_BYTES;
+
+struct FrameRecord {
+    uint16_t codec;
+    uint16_t reserved;
+    uint32_t size;      // payload bytes following the record
+};
+
+struct EncodedFrame {
+    uint16_t codec;
+    uint32_t size;
+    uint8_t data[MAX_ENCODED_FRAME_BYTES];
+};
+
+// Keyframes don't depend on the previous frame, decoding can start at any
+// of them
+inline bool is_keyframe(uint16_t codec) {
+    return codec == CODEC_RAW || codec == CODEC_RLE_KEY || codec == CODEC_QUADTREE || codec == CODEC_GRAY_RAW;
+}
+
+// Whether CODEC_GRAY_RAW frames decode to 16 dithered levels instead of
+// the full ramp, takes effect at the next frame
+extern void set_gray_dither(bool on);
+
+// What it took to decode a frame
+struct DecodeStats {
+    uint32_t fills = 0;     // runs or rectangles written
+    uint32_t nodes = 0;     // quadtree nodes visited (CODEC_QUADTREE only)
+};
+
+// Decode a frame into a VGA_WIDTH x VGA_HEIGHT buffer of palette indices
+// (4 byte aligned). Runs are written as word-wide fills. Delta frames are
+// applied on top of whatever "dst" already holds, which must be the
+// previous frame.
+//
+// Returns false if the payload is malformed, "dst" may be partially
+// updated in that case. "stats", if not null, is incremented.
+extern bool decode_frame(uint16_t codec, const uint8_t* data, uint32_t size, uint8_t* dst, uint8_t black, uint8_t white, DecodeStats* stats = nullptr);
+
+// Same as decode_frame() but only writes scanlines [y0, y1), so disjoint
+// bands of one frame can be decoded in parallel. The payload is still
+// parsed up to the end of the band; only a band that ends at VGA_HEIGHT
+// checks that nothing follows the frame. Work is counted in "stats" by
+// the band it starts in, so the bands' stats add up to decode_frame()'s.
+extern bool decode_frame_rows(uint16_t codec, const uint8_t* data, uint32_t size, uint8_t* dst, uint8_t black, uint8_t white,
+                              uint32_t y0, uint32_t y1, DecodeStats* stats = nullptr);
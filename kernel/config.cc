@@ -61,6 +61,21 @@ struct IOAPIC_ENTRY {
 
 typedef struct IOAPIC_ENTRY IOAPIC_ENTRY;
 
+struct HPET_TABLE {
+    SDT sdt;
+    uint32_t eventTimerBlockId;
+    uint8_t addressSpaceId;     // 0: memory
+    uint8_t registerBitWidth;
+    uint8_t registerBitOffset;
+    uint8_t reserved;
+    uint64_t address;
+    uint8_t hpetNumber;
+    uint16_t minimumTick;
+    uint8_t pageProtection;
+} __attribute__ ((packed));
+
+typedef struct HPET_TABLE HPET_TABLE;
+
 struct RSD {
     char Signature[8];
     uint8_t Checksum;
@@ -172,4 +187,11 @@ void configInit(Config* config) {
     }
 
     config->totalProcs = config->nOtherProcs + 1;
+
+    // we can only map 32 bit physical addresses
+    config->hpet = 0;
+    HPET_TABLE* hpet = (HPET_TABLE*) findSDT(rsdp,"HPET");
+    if (hpet != 0 && hpet->addressSpaceId == 0 && (hpet->address >> 32) == 0) {
+        config->hpet = (uint32_t) hpet->address;
+    }
 }
@@ -19,6 +19,7 @@ struct Config {
     uint32_t localAPIC;
     uint32_t madtFlags;
     uint32_t ioAPIC;
+    uint32_t hpet;              // HPET registers, 0 if there is none
 
     ApicInfo apicInfo[MAX_PROCS];
     char oemid[7];
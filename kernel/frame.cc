@@ -0,0 +1,56 @@
+#include "frame.h"
+#include "machine.h"
+
+namespace {
+
+    // For every possible source byte, the 8 destination bytes as two
+    // little-endian words with 0xFF where the pixel is set. Built at
+    // compile time so the expander is a lookup and a couple of ANDs.
+    struct ExpandTable {
+        uint32_t masks[256][2];
+
+        constexpr ExpandTable() : masks{} {
+            for (uint32_t b = 0; b < 256; b++) {
+                for (uint32_t i = 0; i < 8; i++) {
+                    if (b & (0x80 >> i)) {
+                        masks[b][i / 4] |= uint32_t(0xFF) << (8 * (i % 4));
+                    }
+                }
+            }
+        }
+    };
+
+    constexpr ExpandTable expand_table{};
+
+    static_assert(expand_table.masks[0x80][0] == 0x000000FF);
+    static_assert(expand_table.masks[0x01][1] == 0xFF000000);
+}
+
+void expand_1bpp(const uint8_t* src, uint8_t* dst, uint32_t n, uint8_t black, uint8_t white) {
+    const uint32_t b4 = black * 0x01010101;
+    const uint32_t w4 = white * 0x01010101;
+    auto out = (uint32_t*) dst;
+
+    for (uint32_t i = 0; i < n; i++) {
+        auto m = expand_table.masks[src[i]];
+        out[0] = (w4 & m[0]) | (b4 & ~m[0]);
+        out[1] = (w4 & m[1]) | (b4 & ~m[1]);
+        out += 2;
+    }
+}
+
+void fill_run(uint8_t* p, uint32_t n, uint8_t color) {
+    while (n > 0 && ((uintptr_t) p & 3) != 0) {
+        *p++ = color;
+        n--;
+    }
+    if (n >= 4) {
+        memset32(p, color * 0x01010101, n / 4);
+        p += n & ~3;
+        n &= 3;
+    }
+    while (n > 0) {
+        *p++ = color;
+        n--;
+    }
+}
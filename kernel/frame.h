@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include "vga.h"
+
+// A full screen black and white frame packed 8 pixels per byte. Within a
+// byte the most significant bit is the leftmost pixel, rows are stored top
+// to bottom with no padding (VGA_WIDTH is a multiple of 8).
+//
+// 8000 bytes per frame instead of the 64000 needed by a palette-index
+// frame, a minute of video at 30fps fits in ~14MB.
+constexpr uint32_t PACKED_FRAME_BYTES = VGA_WIDTH * VGA_HEIGHT / 8;
+constexpr uint32_t PACKED_ROW_BYTES = VGA_WIDTH / 8;
+
+struct PackedFrame {
+    uint8_t bits[PACKED_FRAME_BYTES];
+
+    bool get(uint32_t x, uint32_t y) const {
+        return (bits[y * PACKED_ROW_BYTES + x / 8] >> (7 - (x % 8))) & 1;
+    }
+
+    void set(uint32_t x, uint32_t y, bool white) {
+        uint8_t mask = 0x80 >> (x % 8);
+        uint8_t& b = bits[y * PACKED_ROW_BYTES + x / 8];
+        b = white ? (b | mask) : (b & ~mask);
+    }
+};
+
+// Expand "n" packed bytes from "src" into 8*n palette indices in "dst"
+// (0 bits become "black", 1 bits become "white"). Uses a table lookup and
+// two 32 bit stores per source byte, "dst" needs to be 4 byte aligned.
+extern void expand_1bpp(const uint8_t* src, uint8_t* dst, uint32_t n, uint8_t black, uint8_t white);
+
+// memset-style fill of "n" palette indices, byte stores until "p" is
+// aligned then word stores
+extern void fill_run(uint8_t* p, uint32_t n, uint8_t color);
@@ -0,0 +1,122 @@
+#include "frame_stats.h"
+#include "smp.h"
+#include "debug.h"
+#include "sched.h"
+
+namespace FrameStats {
+
+    struct Ring {
+        FrameSample* samples;
+        uint32_t n;         // ever recorded, the newest is at (n - 1) % RING_SAMPLES
+    };
+
+    static PerCPU<Ring> rings;
+    static Sched::Switches start_switches;
+
+    void begin() {
+        for (uint32_t i = 0; i < kConfig.totalProcs; i++) {
+            auto& ring = rings.forCPU(i);
+            if (ring.samples == nullptr) {
+                ring.samples = new FrameSample[RING_SAMPLES];
+            }
+            ring.n = 0;
+        }
+        start_switches = Sched::switches();
+    }
+
+    void record(FrameSample const& sample) {
+        // the thread could be preempted and moved to another core half way
+        Interrupts::protect([&sample] {
+            auto& ring = rings.mine();
+            if (ring.samples == nullptr) return;    // begin() was never called
+            ring.samples[ring.n % RING_SAMPLES] = sample;
+            ring.n += 1;
+        });
+    }
+
+    // shell sort, the sample counts are small
+    template <typename T>
+    static void sort(T* a, uint32_t n) {
+        for (uint32_t gap = n / 2; gap > 0; gap /= 2) {
+            for (uint32_t i = gap; i < n; i++) {
+                T v = a[i];
+                uint32_t j = i;
+                for (; j >= gap && a[j - gap] > v; j -= gap) {
+                    a[j] = a[j - gap];
+                }
+                a[j] = v;
+            }
+        }
+    }
+
+    // "p" percent of the sorted values are at or below the result
+    template <typename T>
+    static T percentile(const T* sorted, uint32_t n, uint32_t p) {
+        return sorted[(n - 1) * p / 100];
+    }
+
+    // dropped frames have no blit (or bytes) to report
+    template <typename T, typename F>
+    static void stage(const char* name, T* values, bool skip_dropped, F const& get) {
+        uint32_t k = 0;
+        for (uint32_t i = 0; i < kConfig.totalProcs; i++) {
+            auto& ring = rings.forCPU(i);
+            uint32_t held = (ring.n < RING_SAMPLES) ? ring.n : RING_SAMPLES;
+            for (uint32_t s = 0; s < held; s++) {
+                auto& sample = ring.samples[s];
+                if (skip_dropped && sample.outcome == DROPPED) continue;
+                values[k++] = get(sample);
+            }
+        }
+        if (k == 0) return;
+        sort(values, k);
+        Debug::printf("| %s p50 %d p99 %d max %d\n", name,
+            percentile(values, k, 50), percentile(values, k, 99), values[k - 1]);
+    }
+
+    void summary() {
+        uint32_t n = 0;
+        uint32_t late = 0;
+        uint32_t dropped = 0;
+        for (uint32_t i = 0; i < kConfig.totalProcs; i++) {
+            auto& ring = rings.forCPU(i);
+            uint32_t held = (ring.n < RING_SAMPLES) ? ring.n : RING_SAMPLES;
+            for (uint32_t s = 0; s < held; s++) {
+                late += ring.samples[s].outcome == LATE;
+                dropped += ring.samples[s].outcome == DROPPED;
+            }
+            n += held;
+        }
+        if (n == 0) return;
+
+        Debug::printf("| frame stats: %d frames, %d late, %d dropped\n", n, late, dropped);
+
+        const auto switches = Sched::switches();
+        Debug::printf("| context switches %d voluntary, %d involuntary (quantum %d jiffies)\n",
+            switches.voluntary - start_switches.voluntary,
+            switches.involuntary - start_switches.involuntary, Sched::quantum());
+
+        auto values = new uint32_t[n];
+        stage("decode us", values, false, [](FrameSample const& s) { return s.decode; });
+        stage("blit us  ", values, true, [](FrameSample const& s) { return s.blit; });
+        stage("bytes    ", values, true, [](FrameSample const& s) { return s.bytes; });
+        stage("fills    ", values, false, [](FrameSample const& s) { return s.fills; });
+        stage("nodes    ", values, false, [](FrameSample const& s) { return s.nodes; });
+        delete[] values;
+
+        // for slack the interesting end is the low one
+        auto slack = new int32_t[n];
+        uint32_t k = 0;
+        for (uint32_t i = 0; i < kConfig.totalProcs; i++) {
+            auto& ring = rings.forCPU(i);
+            uint32_t held = (ring.n < RING_SAMPLES) ? ring.n : RING_SAMPLES;
+            for (uint32_t s = 0; s < held; s++) {
+                slack[k++] = ring.samples[s].slack;
+            }
+        }
+        sort(slack, k);
+        Debug::printf("| slack jiffies p50 %d p1 %d min %d\n",
+            percentile(slack, k, 50), percentile(slack, k, 1), slack[0]);
+        delete[] slack;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+// Per-frame playback instrumentation.
+//
+// The player records one FrameSample per frame into a ring owned by the
+// core it is running on (no locking, no shared cache lines) and dumps a
+// summary over serial when playback ends: p50/p99/max of every stage, the
+// low end of the slack, and the drop and late counts, so the $*.raw files
+// `make tN.test` leaves behind can be compared between runs. A ring keeps
+// the last RING_SAMPLES frames.
+//
+// Times are in microseconds, from the clocksource (see clock.h).
+namespace FrameStats {
+
+    constexpr uint32_t RING_SAMPLES = 2048;
+
+    enum Outcome : uint8_t {
+        ON_TIME = 0,
+        LATE = 1,
+        DROPPED = 2,
+    };
+
+    struct FrameSample {
+        uint32_t frame;
+        uint32_t decode;    // us to decode (and scale) the frame
+        uint32_t blit;      // us to present it, 0 if dropped (*)
+        uint32_t bytes;     // bytes written to video memory
+        uint32_t fills;     // runs or rectangles decoded (see DecodeStats)
+        uint32_t nodes;     // quadtree nodes visited
+        int32_t slack;      // jiffies left before the deadline, negative if late
+        Outcome outcome;
+    };
+
+    // (*) In VBE modes the render bands scale straight into the hidden page
+    // (Raster::render), so that copy counts as decode and "blit" is only the
+    // page flip, the wait for the retrace it takes effect in and any
+    // palette upload. "bytes" is still the whole scaled frame.
+
+    // forget every sample
+    extern void begin();
+
+    extern void record(FrameSample const& sample);
+
+    // print the summary (nothing if there are no samples)
+    extern void summary();
+}
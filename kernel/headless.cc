@@ -0,0 +1,115 @@
+#include "headless.h"
+#include "vga.h"
+#include "kernel.h"
+#include "clock.h"
+#include "machine.h"
+#include "debug.h"
+
+namespace Headless {
+
+    constexpr uint32_t FNV_OFFSET = 0x811C9DC5;
+    constexpr uint32_t FNV_PRIME = 0x01000193;
+
+    static bool on = false;
+    static uint32_t dump_every = 0;     // 0: never
+    static uint32_t digest = FNV_OFFSET;
+    static uint32_t frames = 0;
+    static uint64_t start_us = 0;
+
+    void configure() {
+        auto file = fs->find(fs->root, "/video/headless");
+        on = !(file == nullptr) && file->is_file();
+        dump_every = 0;
+        if (!on) return;
+
+        char text[16];
+        auto n = file->read_all(0, sizeof(text) - 1, text);
+        for (int64_t i = 0; i < n && text[i] >= '0' && text[i] <= '9'; i++) {
+            dump_every = dump_every * 10 + (text[i] - '0');
+        }
+        Debug::printf("| headless, dumping every %d frames\n", dump_every);
+    }
+
+    bool enabled() {
+        return on;
+    }
+
+    static uint32_t hash(const uint8_t* pixels) {
+        auto words = (const uint32_t*) pixels;
+        uint32_t h = FNV_OFFSET;
+        for (uint32_t i = 0; i < VGA_WIDTH * VGA_HEIGHT / 4; i++) {
+            h = (h ^ words[i]) * FNV_PRIME;
+        }
+        return h;
+    }
+
+    // append "v" in hex
+    static char* put_hex(char* p, uint32_t v) {
+        char digits[8];
+        uint32_t n = 0;
+        do {
+            digits[n++] = "0123456789abcdef"[v & 0xF];
+            v >>= 4;
+        } while (v != 0);
+        while (n > 0) *p++ = digits[--n];
+        return p;
+    }
+
+    // runs per record, " ffxffff" is at most 8 characters so a record stays
+    // well under what one Debug::printf call prints
+    constexpr uint32_t RUNS_PER_RECORD = 64;
+
+    // Every record is built in one buffer and printed with one call, so
+    // lines from other cores can't end up in the middle of it. Only the
+    // player thread dumps, and kernel stacks are small
+    static void dump(uint32_t n, const uint8_t* pixels) {
+        static char line[RUNS_PER_RECORD * 8 + 1];
+
+        for (uint32_t y = 0; y < VGA_HEIGHT; y++) {
+            auto row = pixels + y * VGA_WIDTH;
+            char* p = line;
+            uint32_t runs = 0;
+            bool first = true;
+            uint32_t x = 0;
+            while (x < VGA_WIDTH) {
+                uint32_t run = 1;
+                while (x + run < VGA_WIDTH && row[x + run] == row[x]) run++;
+                *p++ = ' ';
+                p = put_hex(p, row[x]);
+                *p++ = 'x';
+                p = put_hex(p, run);
+                x += run;
+                runs += 1;
+
+                if (runs == RUNS_PER_RECORD || x == VGA_WIDTH) {
+                    *p = 0;
+                    Debug::printf("| %s %d %d%s\n", first ? "rle" : "rle+", n, y, line);
+                    p = line;
+                    runs = 0;
+                    first = false;
+                }
+            }
+        }
+    }
+
+    void begin() {
+        digest = FNV_OFFSET;
+        frames = 0;
+        start_us = Clock::now_us();
+    }
+
+    void frame(uint32_t n, const uint8_t* pixels) {
+        const uint32_t h = hash(pixels);
+        const uint32_t t_us = uint32_t(Clock::now_us() - start_us);
+        Debug::printf("| frame %d hash %x t_us %d\n", n, h, t_us);
+        if (dump_every != 0 && n % dump_every == 0) {
+            dump(n, pixels);
+        }
+        digest = (digest ^ h) * FNV_PRIME;
+        frames += 1;
+    }
+
+    void end() {
+        Debug::printf("*** headless %d frames digest %x\n", frames, digest);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+// Headless verification mode for playback.
+//
+// Turned on by putting a file named /video/headless on the test disk. Its
+// contents, if any, are a decimal N: every Nth frame (starting with frame
+// 0) is also dumped. In this mode the player never waits for deadlines
+// and never drops, it decodes every frame and, instead of showing it,
+// prints over serial
+//
+//     | frame <n> hash <h> t_us <t>
+//
+// where <h> is a 32 bit FNV-1a hash (in hex) of the VGA_WIDTH x VGA_HEIGHT
+// back buffer, taken a word at a time, and <t> the microseconds since
+// playback started. When playback ends one line sums it all up:
+//
+//     *** headless <frames> frames digest <d>
+//
+// <d> hashes every frame hash in order, so a .ok file with that line,
+// taken from a run that was checked by eye, checks every frame of later
+// runs against it.
+//
+// A dumped frame follows its hash line as one record per scanline:
+//
+//     | rle <n> <y> <color>x<count> <color>x<count> ...
+//
+// with the colors and counts in hex and the counts adding up to
+// VGA_WIDTH, enough for a host script to rebuild the image. A record
+// holds at most 64 runs. A busier scanline goes on in continuation
+// records, in order, that only differ in the tag:
+//
+//     | rle+ <n> <y> <color>x<count> ...
+//
+// A reader appends their runs to the last "rle" record with the same
+// <n> and <y>. Lines from other cores may come in between.
+namespace Headless {
+
+    // read /video/headless, called when a stream is opened
+    extern void configure();
+
+    extern bool enabled();
+
+    // start the clock and the digest
+    extern void begin();
+
+    // hash (and maybe dump) the frame the back buffer holds
+    extern void frame(uint32_t n, const uint8_t* pixels);
+
+    // print the digest line
+    extern void end();
+}
@@ -6,8 +6,10 @@
 extern "C" void resetEIP(void);
 
 extern "C" int inb(int port);
+extern "C" int inw(int port);
 extern "C" int inl(int port);
 extern "C" void outb(int port, int val);
+extern "C" void outw(int port, int val);
 extern "C" void outl(int port, int val);
 
 extern "C" uint64_t rdmsr(uint32_t id);
@@ -18,10 +20,13 @@ extern "C" void invlpg(uint32_t va);
 
 extern "C" void apitHandler_(void);
 extern "C" void spuriousHandler_(void);
+extern "C" void wakeupHandler_(void);
 extern "C" void pageFaultHandler_(void);
 
 extern "C" void* memcpy(void *dest, const void* src, size_t n);
 extern "C" void* bzero(void *dest, size_t n);
+extern "C" void memcpy32(void *dest, const void* src, size_t words);
+extern "C" void memset32(void *dest, uint32_t value, size_t words);
 
 extern "C" void sti();
 extern "C" void cli();
@@ -29,6 +34,9 @@ extern "C" uint32_t getCR3();
 extern "C" uint32_t getFlags();
 extern "C" void monitor(uintptr_t);
 extern "C" void mwait();
+// enable interrupts and halt until one arrives, sti's one instruction
+// delay means one that is already pending still wakes us
+extern "C" void sti_hlt();
 
 struct cpuid_out {
     uint32_t a;
@@ -39,6 +47,9 @@ struct cpuid_out {
 
 extern "C" void cpuid(uint32_t eax, cpuid_out* out);
 
+// time stamp counter, in cycles
+extern "C" uint64_t rdtsc();
+
 extern bool disable();
 extern void enable(bool wasDisabled);
 
@@ -0,0 +1,66 @@
+#include "modex.h"
+#include "vga.h"
+#include "machine.h"
+
+namespace {
+    constexpr uint32_t ROW_BYTES = MODEX_WIDTH / 4;
+    constexpr uint32_t PAGE_BYTES = ROW_BYTES * MODEX_HEIGHT;
+    constexpr uint32_t TOP = (MODEX_HEIGHT - VGA_HEIGHT) / 2;
+
+    static_assert(PAGE_BYTES * MODEX_PAGES <= 0x10000);
+
+    // the page that is currently being scanned out
+    uint32_t visible = 0;
+
+    inline void set_map_mask(uint8_t planes) {
+        outb(VGA_SEQ_INDEX, 0x02);
+        outb(VGA_SEQ_DATA, planes);
+    }
+
+    inline void set_start_address(uint32_t offset) {
+        outb(VGA_CRTC_INDEX, 0x0C);
+        outb(VGA_CRTC_DATA, offset >> 8);
+        outb(VGA_CRTC_INDEX, 0x0D);
+        outb(VGA_CRTC_DATA, offset & 0xFF);
+    }
+}
+
+void modex_init() {
+    write_regs(g_320x240x256x);
+
+    // every write goes to all 4 planes, clear all pages at once
+    set_map_mask(0x0F);
+    memset32((void*) VGA_ADDRESS, 0, 0x10000 / 4);
+
+    visible = 0;
+    set_start_address(0);
+}
+
+void modex_present(const uint8_t* pixels) {
+    const uint32_t hidden = (visible + 1) % MODEX_PAGES;
+    auto page = (volatile uint32_t*) (VGA_ADDRESS + hidden * PAGE_BYTES + TOP * ROW_BYTES);
+
+    // one pass per plane, gathering every 4th pixel so each word store
+    // covers 4 pixels of that plane
+    for (uint32_t plane = 0; plane < 4; plane++) {
+        set_map_mask(1 << plane);
+        for (uint32_t y = 0; y < VGA_HEIGHT; y++) {
+            auto src = pixels + y * VGA_WIDTH + plane;
+            auto dst = page + y * ROW_BYTES / 4;
+            for (uint32_t i = 0; i < ROW_BYTES / 4; i++) {
+                dst[i] = uint32_t(src[0]) | (uint32_t(src[4]) << 8) |
+                    (uint32_t(src[8]) << 16) | (uint32_t(src[12]) << 24);
+                src += 16;
+            }
+        }
+    }
+
+    // The CRTC latches the start address at the beginning of vertical
+    // retrace. vga_wait_retrace() lets a retrace that is already under
+    // way end first, so it returns at the start of the one that picks the
+    // new page up, and nobody draws into the page we are leaving before
+    // that.
+    set_start_address(hidden * PAGE_BYTES);
+    vga_wait_retrace();
+    visible = hidden;
+}
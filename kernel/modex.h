@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+// Unchained 320x240 256 color mode ("mode X") with hardware page flipping.
+//
+// With chain-4 off, pixel (x, y) lives in plane x % 4 at offset
+// y * 80 + x / 4, so a page only needs 19200 bytes of each plane and
+// MODEX_PAGES of them fit in the 64KB plane window. Frames are always
+// drawn into a hidden page and shown by moving the CRTC start address
+// during vertical retrace, so there is no tearing and no clear-then-draw
+// flicker. Nothing ever draws the visible page so it never needs to be
+// cleared.
+
+#define MODEX_WIDTH 320
+#define MODEX_HEIGHT 240
+#define MODEX_PAGES 3
+
+// switch to mode X and clear every page
+void modex_init();
+
+// Draw a VGA_WIDTH x VGA_HEIGHT buffer of palette indices (centered
+// vertically) into the next hidden page then flip to it. Returns once the
+// new page is on the screen.
+void modex_present(const uint8_t* pixels);
@@ -0,0 +1,41 @@
+#include "pacer.h"
+#include "pit.h"
+#include "threads.h"
+
+FramePacer::FramePacer(uint32_t fps): FramePacer(fps, Pit::secondsToJiffies(1) / fps) {
+}
+
+FramePacer::FramePacer(uint32_t fps, uint32_t max_late): fps(fps), max_late(max_late) {
+    ASSERT(fps != 0);
+    reset();
+}
+
+void FramePacer::reset() {
+    start = Pit::jiffies;
+}
+
+uint32_t FramePacer::deadline(uint32_t frame) {
+    // whole seconds first, frame * hz alone wraps after a few hours
+    const uint32_t hz = Pit::secondsToJiffies(1);
+    return start + frame / fps * hz + frame % fps * hz / fps;
+}
+
+bool FramePacer::wait(uint32_t frame) {
+    const uint32_t due = deadline(frame);
+    const uint32_t now = Pit::jiffies;
+    slack = int32_t(due - now);
+
+    // differences, not comparisons, so jiffies wrapping doesn't matter
+    // (as in sleep_until)
+    if (int32_t(now - due) > int32_t(max_late)) {
+        dropped += 1;
+        return false;
+    }
+    if (int32_t(now - due) > 0) {
+        late += 1;
+    } else {
+        sleep_until(due);
+    }
+    presented += 1;
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// Computes absolute per-frame deadlines from Pit::jiffies and puts the
+// calling thread to sleep until they arrive, so the frame rate doesn't
+// depend on how fast the host runs and the core is free between frames.
+//
+// Deadlines are derived from the start time and the frame number (not by
+// adding a period to the previous deadline) so rounding never accumulates.
+//
+// Drop policy: a frame that is still pending more than "max_late" jiffies
+// after its deadline is dropped. The caller is expected to keep decoding
+// it (delta codecs need every frame) but to skip presenting it, which lets
+// the player catch up instead of falling further behind.
+class FramePacer {
+    const uint32_t fps;
+    const uint32_t max_late;
+    uint32_t start;
+
+public:
+    uint32_t presented = 0;
+    uint32_t late = 0;          // presented after the deadline but within max_late
+    uint32_t dropped = 0;
+    int32_t slack = 0;          // jiffies to spare at the last wait(), negative if late
+
+    // max_late defaults to one frame period
+    FramePacer(uint32_t fps);
+    FramePacer(uint32_t fps, uint32_t max_late);
+
+    // restart the clock, frame 0 is due now (the counters keep counting)
+    void reset();
+
+    // the jiffies at which "frame" should be presented
+    uint32_t deadline(uint32_t frame);
+
+    // Sleep until the deadline for "frame". Returns false if the frame
+    // should be dropped instead of presented
+    bool wait(uint32_t frame);
+};
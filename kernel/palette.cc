@@ -0,0 +1,188 @@
+#include "palette.h"
+#include "vga.h"
+#include "vbe.h"
+#include "machine.h"
+#include "blocking_lock.h"
+#include "libk.h"
+
+#define VGA_DAC_READ_INDEX  0x3C7
+#define VGA_DAC_WRITE_INDEX 0x3C8
+#define VGA_DAC_DATA        0x3C9
+
+namespace Palette {
+
+    enum Kind { NONE, FADE_IN, FADE_OUT, CROSS_FADE, CYCLE };
+
+    struct Effect {
+        Kind kind;
+        uint32_t start;
+        uint32_t length;        // frames, or the period for CYCLE
+        uint32_t first;         // the cycled range
+        uint32_t count;
+    };
+
+    static Color base[SIZE];
+    static Color target[SIZE];
+    static Color shown[SIZE];   // what the DAC holds
+    static Color next[SIZE];    // tick() builds the new palette here
+    static Effect effect{NONE, 0, 0, 0, 0};
+    static BlockingLock* lock = nullptr;
+
+    void init() {
+        if (lock != nullptr) return;
+        lock = new BlockingLock();
+
+        outb(VGA_DAC_READ_INDEX, 0);
+        for (uint32_t i = 0; i < SIZE; i++) {
+            shown[i].r = inb(VGA_DAC_DATA);
+            shown[i].g = inb(VGA_DAC_DATA);
+            shown[i].b = inb(VGA_DAC_DATA);
+        }
+
+        // black to white, the DAC is idle so no need to wait for retrace
+        outb(VGA_DAC_WRITE_INDEX, VGA_GRAY_BASE);
+        for (uint32_t i = 0; i < VGA_GRAY_LEVELS; i++) {
+            const uint8_t v = uint8_t(i * MAX_LEVEL / (VGA_GRAY_LEVELS - 1));
+            shown[VGA_GRAY_BASE + i] = Color{v, v, v};
+            outb(VGA_DAC_DATA, v);
+            outb(VGA_DAC_DATA, v);
+            outb(VGA_DAC_DATA, v);
+        }
+        memcpy(base, shown, sizeof(base));
+        memcpy(target, shown, sizeof(target));
+    }
+
+    void set(uint32_t first, uint32_t count, const Color* colors) {
+        if (first >= SIZE) return;
+        count = K::min(count, SIZE - first);
+        lock->lock();
+        memcpy(&base[first], colors, count * sizeof(Color));
+        lock->unlock();
+    }
+
+    Color get(uint32_t index) {
+        return base[index % SIZE];
+    }
+
+    void set_target(uint32_t first, uint32_t count, const Color* colors) {
+        if (first >= SIZE) return;
+        count = K::min(count, SIZE - first);
+        lock->lock();
+        memcpy(&target[first], colors, count * sizeof(Color));
+        lock->unlock();
+    }
+
+    static void begin(Effect const& e) {
+        lock->lock();
+        effect = e;
+        lock->unlock();
+    }
+
+    void fade_in(uint32_t start, uint32_t length) {
+        begin(Effect{FADE_IN, start, K::max(length, 1u), 0, 0});
+    }
+
+    void fade_out(uint32_t start, uint32_t length) {
+        begin(Effect{FADE_OUT, start, K::max(length, 1u), 0, 0});
+    }
+
+    void cross_fade(uint32_t start, uint32_t length) {
+        begin(Effect{CROSS_FADE, start, K::max(length, 1u), 0, 0});
+    }
+
+    void cycle(uint32_t first, uint32_t count, uint32_t start, uint32_t period) {
+        if (first >= SIZE) return;
+        count = K::min(count, SIZE - first);
+        if (count < 2) {
+            // nothing to rotate
+            stop();
+            return;
+        }
+        begin(Effect{CYCLE, start, K::max(period, 1u), first, count});
+    }
+
+    void stop() {
+        begin(Effect{NONE, 0, 0, 0, 0});
+    }
+
+    // a + (b - a) * t / length, per channel
+    static inline Color blend(Color a, Color b, uint32_t t, uint32_t length) {
+        auto mix = [t, length](uint8_t x, uint8_t y) {
+            return uint8_t((x * (length - t) + y * t) / length);
+        };
+        return Color{mix(a.r, b.r), mix(a.g, b.g), mix(a.b, b.b)};
+    }
+
+    // fill "next" for frame n, with the lock held
+    static void compute(uint32_t n) {
+        const uint32_t t = (n > effect.start) ? n - effect.start : 0;
+        const uint32_t length = effect.length;
+        const Color black{0, 0, 0};
+
+        switch (effect.kind) {
+        case NONE:
+            memcpy(next, base, sizeof(next));
+            break;
+        case FADE_IN:
+        case FADE_OUT: {
+            uint32_t step = K::min(t, length);
+            if (effect.kind == FADE_OUT) step = length - step;
+            for (uint32_t i = 0; i < SIZE; i++) {
+                next[i] = blend(black, base[i], step, length);
+            }
+            if (effect.kind == FADE_IN && t >= length) effect.kind = NONE;
+            break;
+        }
+        case CROSS_FADE:
+            if (t >= length) {
+                memcpy(base, target, sizeof(base));
+                memcpy(next, base, sizeof(next));
+                effect.kind = NONE;
+                break;
+            }
+            for (uint32_t i = 0; i < SIZE; i++) {
+                next[i] = blend(base[i], target[i], t, length);
+            }
+            break;
+        case CYCLE: {
+            memcpy(next, base, sizeof(next));
+            const uint32_t shift = (t / length) % effect.count;
+            for (uint32_t i = 0; i < effect.count; i++) {
+                next[effect.first + (i + shift) % effect.count] = base[effect.first + i];
+            }
+            break;
+        }
+        }
+    }
+
+    static inline bool same(Color a, Color b) {
+        return a.r == b.r && a.g == b.g && a.b == b.b;
+    }
+
+    void tick(uint32_t frame, bool wait) {
+        // direct color VBE modes don't go through the DAC
+        if (VBE::width() != 0 && VBE::bpp() != 8) return;
+
+        lock->lock();
+        compute(frame);
+
+        // the DAC auto-increments its index, so send the one range that
+        // covers every change
+        uint32_t lo = 0;
+        while (lo < SIZE && same(next[lo], shown[lo])) lo++;
+        if (lo < SIZE) {
+            uint32_t hi = SIZE;
+            while (same(next[hi - 1], shown[hi - 1])) hi--;
+
+            if (wait) vga_wait_retrace();
+            outb(VGA_DAC_WRITE_INDEX, lo);
+            for (uint32_t i = lo; i < hi; i++) {
+                outb(VGA_DAC_DATA, next[i].r);
+                outb(VGA_DAC_DATA, next[i].g);
+                outb(VGA_DAC_DATA, next[i].b);
+                shown[i] = next[i];
+            }
+        }
+        lock->unlock();
+    }
+}
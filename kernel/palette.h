@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+// The 256 entry VGA DAC.
+//
+// Changing what every pixel of a palette index looks like is 3 port
+// writes, so fades and color cycling go through the palette instead of
+// rewriting the framebuffer: a full screen fade step is 768 writes to
+// 0x3C9 instead of VGA_WIDTH * VGA_HEIGHT pixels.
+//
+// There is one base palette (what the frames are drawn for) and at most
+// one effect at a time. Effects are timed in frames, tick(n) works out
+// the palette for frame n and, if it differs from what the DAC holds,
+// uploads the changed entries during a vertical retrace so the change
+// doesn't tear. Without an effect tick() costs a compare.
+namespace Palette {
+
+    constexpr uint32_t SIZE = 256;
+    constexpr uint32_t MAX_LEVEL = 63;  // the DAC has 6 bits per channel
+
+    struct Color {
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+    };
+
+    // Read the palette the BIOS left in the DAC as the base palette and
+    // load the gray ramp (VGA_GRAY_BASE in vga.h) into it, and the DAC
+    extern void init();
+
+    // change base palette entries, visible at the next tick()
+    extern void set(uint32_t first, uint32_t count, const Color* colors);
+    extern Color get(uint32_t index);
+
+    // the palette cross_fade() blends towards
+    extern void set_target(uint32_t first, uint32_t count, const Color* colors);
+
+    // from black to the base palette over frames [start, start + length)
+    extern void fade_in(uint32_t start, uint32_t length);
+
+    // from the base palette to black, the screen stays black afterwards
+    extern void fade_out(uint32_t start, uint32_t length);
+
+    // from the base palette to the target, which then becomes the base
+    extern void cross_fade(uint32_t start, uint32_t length);
+
+    // rotate entries [first, first + count) by one every "period" frames,
+    // a range of fewer than 2 entries just stops the current effect
+    extern void cycle(uint32_t first, uint32_t count, uint32_t start, uint32_t period);
+
+    // cancel the effect, the next tick() shows the base palette
+    extern void stop();
+
+    // show the palette for frame n, "wait" for the next retrace before
+    // touching the DAC unless the caller has just seen one start
+    extern void tick(uint32_t frame, bool wait = true);
+}
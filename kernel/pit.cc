@@ -4,6 +4,9 @@
 #include "idt.h"
 #include "smp.h"
 #include "threads.h"
+#include "clock.h"
+#include "libk.h"
+#include "sched.h"
 
 /*
  * The old PIT runs at a fixed frequency of 1193182Hz but doesn't support
@@ -28,9 +31,17 @@ constexpr uint32_t PIT_FREQ = 1193182;
 /* Were we want the APIT to iunterrupt us */
 constexpr uint32_t APIT_vector = 40; 
 
+/* IPI that wakes a core halted in Pit::idle */
+constexpr uint32_t WAKEUP_vector = 41;
+
+/* the longest an idle core sleeps, in case a wakeup gets lost */
+constexpr uint32_t MAX_IDLE_JIFFIES = 1000;
+
 uint32_t Pit::jiffiesPerSecond = 0;
 uint32_t Pit::apitCounter = 0;
 uint32_t Pit::jiffies = 0;
+bool Pit::ticklessIdle = false;
+Atomic<uint32_t> Pit::idleCores{0};
 
 struct PitInfo {
 };
@@ -86,6 +97,8 @@ void Pit::calibrate(uint32_t hz) {
     outb(0x42,d);
     outb(0x42,d >> 8);
 
+    // the TSC gets measured over the same second
+    const uint64_t tsc_start = rdtsc();
     uint32_t last = inb(0x61) & 0x20;
     uint32_t changes = 0;
     // The PIT counts twice as fast when it runs in the
@@ -102,6 +115,7 @@ void Pit::calibrate(uint32_t hz) {
     }
     
     uint32_t diff = initial - SMP::apit_current_count.get();
+    const uint64_t tsc_hz = rdtsc() - tsc_start;
 
     // stop the PIT
     outb(0x61,0);
@@ -111,8 +125,13 @@ void Pit::calibrate(uint32_t hz) {
     jiffiesPerSecond = hz;
     Debug::printf("| APIT counter=%d for %dHz\n",apitCounter,hz);
 
+    Clock::init(tsc_hz);
+    ticklessIdle = Clock::source() != Clock::JIFFIES;
+    Debug::printf("| tickless idle %s\n", ticklessIdle ? "on" : "off");
+
     // Register the APIT interrupt handler
     IDT::interrupt(APIT_vector, (uint32_t)apitHandler_);
+    IDT::interrupt(WAKEUP_vector, (uint32_t)wakeupHandler_);
 }
 
 // Called by each CPU in order to initialize its own PIT
@@ -125,6 +144,11 @@ void Pit::init() {
 
     // The following line will enable timer interrupts for this CPU
     // You better be prepared for it
+    periodic();
+}
+
+// tick every jiffy
+void Pit::periodic() {
     SMP::apit_lvt_timer.set(
         (1 << 17) |      // Timer mode: 1 -> Periodic
         0 << 16   |      // mask: 0 -> interrupts not masked
@@ -135,21 +159,71 @@ void Pit::init() {
     SMP::apit_initial_count.set(apitCounter);
 }
 
+// interrupt once, "n" jiffies from now
+void Pit::one_shot(uint32_t n) {
+    SMP::apit_lvt_timer.set(
+        (0 << 17) |      // Timer mode: 0 -> One-shot
+        0 << 16   |      // mask: 0 -> interrupts not masked
+        APIT_vector
+    );
+    SMP::apit_initial_count.set(apitCounter * n);
+}
+
+void Pit::tick() {
+    if (!ticklessIdle) {
+        // only core 0 counts, the others would count the same ticks again
+        if (SMP::me() == 0) jiffies ++;
+        return;
+    }
+    // Any core can be the one that is awake. The clock says how many
+    // jiffies have passed, move forward to that (never back)
+    const uint32_t us_per_jiffy = 1000000 / jiffiesPerSecond;
+    const uint32_t target = uint32_t(Clock::now_us() / us_per_jiffy);
+    uint32_t seen = __atomic_load_n(&jiffies, __ATOMIC_SEQ_CST);
+    while (int32_t(target - seen) > 0 &&
+           !__atomic_compare_exchange_n(&jiffies, &seen, target, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+    }
+}
+
+void Pit::idle(uint32_t at_jiffies, bool (*has_work)()) {
+    if (!ticklessIdle) return;
+
+    const uint32_t bit = 1 << SMP::me();
+    const bool was = Interrupts::disable();
+    idleCores.fetch_or(bit);
+    if (!has_work()) {
+        tick();         // jiffies may be stale if every core was asleep
+        int32_t n = int32_t(at_jiffies - jiffies);
+        if (n > 0) {
+            one_shot(K::min(uint32_t(n), MAX_IDLE_JIFFIES, 0xFFFFFFFF / apitCounter));
+            sti_hlt();  // any interrupt, then back here with them enabled
+            cli();
+            periodic();
+        }
+    }
+    idleCores.fetch_and(~bit);
+    Interrupts::restore(was);
+}
+
+void Pit::kick(uint32_t id) {
+    const uint32_t others = idleCores.get() & ~(1 << SMP::me());
+    if (others == 0) return;
+
+    // one core is enough, it runs or steals the work
+    const uint32_t target = ((others & (1 << id)) != 0) ? id : __builtin_ctz(others);
+    Interrupts::protect([target] {
+        SMP::ipi(target, WAKEUP_vector);
+    });
+}
+
+extern "C" void wakeupHandler() {
+    // all it had to do was interrupt the hlt
+    SMP::eoi_reg.set(0);
+}
+
 extern "C" void apitHandler(uint32_t* things) {
-    using namespace impl::threads;
     // interrupts are disabled.
-    auto id = SMP::me();                     // O(1)
-    if (id == 0) {                           // O(1)
-        Pit::jiffies ++;                     // O(1)
-    }                                        // O(1)
+    Pit::tick();                             // O(1)
     SMP::eoi_reg.set(0);                     // O(1)
-    #if 0
-    auto tcb = state.active_thread[id];      // O(1)
-    if (tcb != nullptr) {
-        state.block("pit", [tcb] {                  // O(1)
-            // Done in the helper thread, not O(1)
-            state.ready_queue.add(tcb);
-        });
-    }                                    // O(1)
-    #endif
+    Sched::tick();                           // O(1), may switch to the helper
 }
@@ -11,10 +11,33 @@ class Thread;
 class Pit {
     static uint32_t jiffiesPerSecond;
     static uint32_t apitCounter;
+    static bool ticklessIdle;
+    static Atomic<uint32_t> idleCores;      // bit i: core i is halted in idle()
+    static void periodic();
+    static void one_shot(uint32_t n);
 public:
     static uint32_t jiffies;
     static void calibrate(uint32_t hz);
     static void init();
+
+    // Tickless idle. A core with nothing to run stops its periodic tick,
+    // arms a one-shot APIC timer for "at_jiffies" (its next timer) and
+    // halts until then or until kick() sends it an IPI. Only enabled with
+    // a hardware clocksource (clock.h): jiffies are then derived from the
+    // clock by whichever core takes a tick, so they keep moving while core
+    // 0 sleeps. Returns right away if tickless idle is off.
+    //
+    // "has_work" is checked after the core is marked idle and with
+    // interrupts disabled, so work added concurrently is never missed
+    static void idle(uint32_t at_jiffies, bool (*has_work)());
+
+    // new work is queued on core "id": wake it up if it is idle, wake
+    // some other idle core (to steal the work) if it isn't
+    static void kick(uint32_t id);
+
+    // called on every tick, advances jiffies
+    static void tick();
+
     static uint32_t secondsToJiffies(uint32_t secs) {
         return jiffiesPerSecond * secs;
     }
@@ -0,0 +1,256 @@
+#include "player.h"
+#include "kernel.h"
+#include "threads.h"
+#include "pit.h"
+#include "vga.h"
+#include "pacer.h"
+#include "raster.h"
+#include "frame_stats.h"
+#include "headless.h"
+#include "palette.h"
+#include "machine.h"
+#include "libk.h"
+#include "clock.h"
+
+Player::Player(StrongPtr<Node> file, VideoHeader const& header): file(file), header(header) {
+    pool = new EncodedFrame[RING_SIZE];
+    for (uint32_t i = 0; i < RING_SIZE; i++) {
+        auto frame = &pool[i];
+        free_frames.put(frame);
+    }
+}
+
+Player::~Player() {
+    stop();
+    delete[] pool;
+    if (index != nullptr) {
+        delete[] index;
+    }
+    if (nearest != nullptr) {
+        delete[] nearest;
+    }
+}
+
+StrongPtr<Player> Player::open(const char* path) {
+    auto file = fs->find(fs->root, path);
+    if (file == nullptr || !file->is_file()) return {};
+    if (file->size_in_bytes() < sizeof(VideoHeader)) return {};
+
+    VideoHeader header;
+    file->read(0, header);
+    if (header.magic != VideoHeader::MAGIC || header.fps == 0) {
+        Debug::printf("| %s is not a video\n", path);
+        return {};
+    }
+    auto player = StrongPtr<Player>::make(file, header);
+    player->load_index();
+    Headless::configure();
+    return player;
+}
+
+void Player::load_index() {
+    if (header.n_keyframes == 0) return;
+
+    // the count comes from the file, check it against what the file can
+    // hold before it sizes anything
+    const uint32_t size = file->size_in_bytes();
+    if (header.index_offset > size ||
+        header.n_keyframes > (size - header.index_offset) / sizeof(KeyframeEntry) ||
+        header.n_keyframes > header.n_frames ||
+        header.frames_offset > size ||
+        header.n_frames > (size - header.frames_offset) / sizeof(FrameRecord)) {
+        Debug::printf("| ignoring bad keyframe index\n");
+        return;
+    }
+
+    const uint32_t bytes = header.n_keyframes * sizeof(KeyframeEntry);
+    index = new KeyframeEntry[header.n_keyframes];
+    bool ok = file->read_all(header.index_offset, bytes, (char*) index) == bytes;
+
+    for (uint32_t i = 0; ok && i < header.n_keyframes; i++) {
+        ok = index[i].frame < header.n_frames &&
+            is_keyframe(index[i].codec) &&
+            (i == 0 || index[i-1].frame < index[i].frame);
+    }
+
+    if (!ok) {
+        Debug::printf("| ignoring bad keyframe index\n");
+        delete[] index;
+        index = nullptr;
+        return;
+    }
+    n_keyframes = header.n_keyframes;
+
+    // every frame takes at least a FrameRecord of the file (checked
+    // above), so this is at most half the file's size
+    nearest = new uint32_t[header.n_frames];
+    uint32_t k = 0;
+    for (uint32_t f = 0; f < header.n_frames; f++) {
+        while (k < n_keyframes && index[k].frame <= f) k++;
+        nearest[f] = k;
+    }
+}
+
+const KeyframeEntry* Player::keyframe_for(uint32_t frame) {
+    if (n_keyframes == 0) return nullptr;
+    const uint32_t k = (frame < header.n_frames) ? nearest[frame] : n_keyframes;
+    return (k == 0) ? nullptr : &index[k - 1];
+}
+
+// runs in its own thread
+void Player::produce(uint32_t first_frame, uint32_t offset) {
+    for (uint32_t i = first_frame; i < header.n_frames && !cancel.get(); i++) {
+        auto frame = free_frames.get();
+
+        FrameRecord record;
+        bool ok = file->read_all(offset, sizeof(record), (char*) &record) == sizeof(record) &&
+            record.size <= MAX_ENCODED_FRAME_BYTES &&
+            file->read_all(offset + sizeof(record), record.size, (char*) frame->data) == record.size;
+        if (!ok) {
+            Debug::printf("| video truncated at frame %d\n", i);
+            free_frames.put(frame);
+            break;
+        }
+        offset += sizeof(record) + record.size;
+
+        frame->codec = record.codec;
+        frame->size = record.size;
+        bytes_read.add_fetch(sizeof(record) + record.size);
+        n_ready.add_fetch(1);
+        ready_frames.put(frame);
+    }
+
+    EncodedFrame* end = nullptr;
+    ready_frames.put(end);
+    producer_exited.up();
+}
+
+uint32_t Player::start(uint32_t from) {
+    stop();
+
+    uint32_t first = 0;
+    uint32_t offset = header.frames_offset;
+    auto key = keyframe_for(from);
+    if (key != nullptr) {
+        first = key->frame;
+        offset = key->offset;
+    }
+
+    producing = true;
+    ended = false;
+    next = first;
+    bytes_read.set(0);
+    started = Pit::jiffies;
+    thread([this, first, offset] {
+        produce(first, offset);
+    });
+    return first;
+}
+
+bool Player::step(uint32_t draw_from, uint32_t& number, DecodeStats* stats) {
+    if (!producing || ended) return false;
+
+    auto frame = ready_frames.get();
+    if (frame == nullptr) {
+        ended = true;
+        return false;
+    }
+    n_ready.add_fetch(-1);
+    number = next++;
+
+    // always decode, even if the frame ends up dropped, the next delta
+    // frame is relative to this one. Frames we are only catching up
+    // through are not scaled
+    const uint64_t begin = Clock::now_us();
+    const bool draw = number >= draw_from && !Headless::enabled();
+    decoded = DecodeStats{};
+    if (!Raster::render(frame->codec, frame->data, frame->size, draw, &decoded)) {
+        Debug::printf("| frame %d is corrupted (codec %d)\n", number, frame->codec);
+    }
+    decode_us = uint32_t(Clock::now_us() - begin);
+    if (stats != nullptr) {
+        stats->fills += decoded.fills;
+        stats->nodes += decoded.nodes;
+    }
+    free_frames.put(frame);
+    return true;
+}
+
+bool Player::present(FramePacer& pacer, uint32_t frame, uint32_t n) {
+    FrameStats::FrameSample sample{frame, decode_us, 0, 0, decoded.fills, decoded.nodes, 0, FrameStats::DROPPED};
+
+    if (Headless::enabled()) {
+        // no clock and no screen, every frame gets checked
+        Headless::frame(frame, vga_back_buffer());
+        pacer.presented += 1;
+        sample.outcome = FrameStats::ON_TIME;
+        FrameStats::record(sample);
+        return true;
+    }
+
+    const uint32_t late = pacer.late;
+    const bool show = pacer.wait(n);
+    sample.slack = pacer.slack;
+    if (show) {
+        const uint64_t begin = Clock::now_us();
+        auto written = vga_show_frame(frame);
+        sample.blit = uint32_t(Clock::now_us() - begin);
+        sample.bytes = written.bytes_written;
+        sample.outcome = (pacer.late != late) ? FrameStats::LATE : FrameStats::ON_TIME;
+    }
+    FrameStats::record(sample);
+    return show;
+}
+
+void Player::report_throughput() {
+    const uint32_t bytes = bytes_read.get();
+    const uint32_t ms = K::max(uint32_t(uint64_t(Pit::jiffies - started) * 1000 / Pit::secondsToJiffies(1)), 1u);
+    Debug::printf("| streamed %d KB in %d ms, %d KB/s\n", bytes / 1024, ms, bytes / ms);
+}
+
+void Player::stop() {
+    if (!producing) return;
+
+    // hand every frame back until the producer notices and sends the
+    // end marker
+    cancel.set(true);
+    while (!ended) {
+        auto frame = ready_frames.get();
+        if (frame == nullptr) {
+            ended = true;
+        } else {
+            n_ready.add_fetch(-1);
+            free_frames.put(frame);
+        }
+    }
+    producer_exited.down();
+    cancel.set(false);
+    producing = false;
+}
+
+void Player::play(uint32_t from) {
+    if (from >= header.n_frames) return;
+
+    start(from);
+    Palette::fade_in(from, header.fps / 2);
+    FrameStats::begin();
+    if (Headless::enabled()) Headless::begin();
+
+    FramePacer pacer{header.fps};
+    DecodeStats decoded{};
+    uint32_t i;
+    while (step(from, i, &decoded)) {
+        if (i < from) continue;      // catching up to the seek target
+        if (i == from) pacer.reset();
+
+        present(pacer, i, i - from);
+    }
+    Debug::printf("| presented %d frames (%d late), dropped %d\n",
+        pacer.presented, pacer.late, pacer.dropped);
+    Debug::printf("| decoded with %d fills, %d quadtree nodes\n", decoded.fills, decoded.nodes);
+    report_throughput();
+    FrameStats::summary();
+    if (Headless::enabled()) Headless::end();
+
+    stop();
+}
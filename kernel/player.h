@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdint.h>
+#include "ext2.h"
+#include "bb.h"
+#include "semaphore.h"
+#include "atomic.h"
+#include "codec.h"
+#include "pacer.h"
+
+// On-disk layout of a video file:
+//
+//     VideoHeader
+//     n_frames x (FrameRecord + payload), starting at frames_offset
+//     n_keyframes x KeyframeEntry, starting at index_offset
+//
+// see codec.h for the frame encodings. The keyframe index is optional
+// (n_keyframes == 0), without it seeking has to decode from frame 0.
+//
+struct VideoHeader {
+    static constexpr uint32_t MAGIC = 0x41444142; // "BADA"
+
+    uint32_t magic;
+    uint32_t n_frames;
+    uint32_t fps;
+    uint32_t frames_offset;     // byte offset of the first frame
+    uint32_t n_keyframes;
+    uint32_t index_offset;      // byte offset of the keyframe index
+};
+
+// Entries are sorted by frame number
+struct KeyframeEntry {
+    uint32_t frame;
+    uint32_t offset;            // byte offset of the frame's FrameRecord
+    uint16_t codec;
+    uint16_t reserved;
+};
+
+// Plays a video file from the file system.
+//
+// A producer thread streams encoded frames from the file into a bounded
+// ring while the caller (the consumer) decodes each one straight into the
+// back buffer and presents it at its deadline. Disk latency is absorbed by
+// the ring instead of showing up as late frames.
+//
+// The keyframe index is loaded once when the file is opened, together
+// with a table that maps every frame to the closest keyframe at or before
+// it. Starting playback at frame T costs one load from that table plus
+// decoding the frames between that keyframe and T (without presenting
+// them).
+//
+// play() does all of that in one call. A caller that needs to pause or
+// seek in the middle (see video.h) drives it with start(), step() and
+// stop() instead; stop() can be followed by another start().
+class Player {
+    static constexpr uint32_t RING_SIZE = 8;
+
+    StrongPtr<Node> file;
+    VideoHeader header;
+
+    EncodedFrame* pool;
+    BB<EncodedFrame*> free_frames{RING_SIZE};    // frames the producer can fill
+    BB<EncodedFrame*> ready_frames{RING_SIZE};   // frames read from disk, nullptr marks the end
+    Semaphore producer_exited{0};
+    Atomic<bool> cancel{false};                 // asks the producer to stop early
+    Atomic<uint32_t> n_ready{0};
+    Atomic<uint32_t> bytes_read{0};             // since start()
+    uint32_t started = 0;                       // jiffies at start()
+
+    bool producing = false;     // between start() and stop()
+    bool ended = false;         // step() has seen the end marker
+    uint32_t next = 0;          // the frame step() decodes next
+    uint32_t decode_us = 0;     // what the last step() took
+    DecodeStats decoded{};      // and the work it did
+
+    KeyframeEntry* index = nullptr;
+    uint32_t n_keyframes = 0;
+    uint32_t* nearest = nullptr;    // frame -> 1 + its keyframe's entry, 0 for none
+
+    void load_index();
+    void produce(uint32_t first_frame, uint32_t offset);
+
+public:
+    Player(StrongPtr<Node> file, VideoHeader const& header);
+    ~Player();
+
+    // Returns a null reference if "path" doesn't exist or is not a video
+    static StrongPtr<Player> open(const char* path);
+
+    uint32_t n_frames() { return header.n_frames; }
+    uint32_t fps() { return header.fps; }
+
+    // The last keyframe at or before "frame", nullptr if there is none. O(1)
+    const KeyframeEntry* keyframe_for(uint32_t frame);
+
+    // Start streaming from the last keyframe at or before "from", returns
+    // the first frame step() will decode
+    uint32_t start(uint32_t from);
+
+    // Decode the next frame into the back buffer (scaling it for the
+    // display if its number is at least "draw_from") and return its number
+    // in "frame". Its fills and nodes are added to "stats", if not null,
+    // and go into the frame's FrameStats sample. Returns false once there
+    // are no more frames
+    bool step(uint32_t draw_from, uint32_t& frame, DecodeStats* stats);
+
+    // Wait for the deadline of "frame", which is "n" frames into the
+    // pacer's clock, and show it unless the pacer drops it. Records a
+    // FrameStats sample either way. Returns true if it was shown
+    bool present(FramePacer& pacer, uint32_t frame, uint32_t n);
+
+    // Stop streaming, returns once the producer is gone
+    void stop();
+
+    // frames read ahead of the decoder
+    uint32_t buffered() { return n_ready.get(); }
+
+    // print how fast frames came off the disk since start()
+    void report_throughput();
+
+    // Play the video starting at frame "from", returns after the last
+    // frame is presented. Expects the display to be initialized (vga_init)
+    void play(uint32_t from = 0);
+};
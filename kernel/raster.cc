@@ -0,0 +1,94 @@
+#include "raster.h"
+#include "vga.h"
+#include "vbe.h"
+#include "codec.h"
+#include "config.h"
+#include "barrier.h"
+#include "blocking_lock.h"
+#include "threads.h"
+#include "libk.h"
+
+namespace Raster {
+
+    struct Job {
+        uint16_t codec;
+        const uint8_t* data;
+        uint32_t size;
+        bool draw;
+    };
+
+    struct Band {
+        DecodeStats stats;
+        bool ok;
+    };
+
+    static uint32_t bands = 0;
+    static Job job;
+    static Band* band = nullptr;
+    static BlockingLock* lock = nullptr;        // one frame at a time
+    static ReusableBarrier* start = nullptr;    // the job is ready
+    static ReusableBarrier* finish = nullptr;   // every band is done
+
+    static void render_band(uint32_t b) {
+        const uint32_t y0 = VGA_HEIGHT * b / bands;
+        const uint32_t y1 = VGA_HEIGHT * (b + 1) / bands;
+        auto& out = band[b];
+
+        out.stats = DecodeStats{};
+        out.ok = vga_draw_encoded_rows(job.codec, job.data, job.size, y0, y1, &out.stats);
+        if (out.ok && job.draw && VBE::width() != 0) {
+            VBE::draw_rows(vga_back_buffer(), y0, y1);
+        }
+    }
+
+    void init() {
+        if (bands != 0) return;
+
+        // bands of a few scanlines are not worth a barrier
+        bands = K::min(kConfig.totalProcs, uint32_t(VGA_HEIGHT / 8));
+        band = new Band[bands];
+        lock = new BlockingLock();
+        start = new ReusableBarrier(bands);
+        finish = new ReusableBarrier(bands);
+
+        for (uint32_t b = 1; b < bands; b++) {
+            thread([b] {
+                while (true) {
+                    start->sync();
+                    render_band(b);
+                    finish->sync();
+                }
+            });
+        }
+        Debug::printf("| rendering in %d bands\n", bands);
+    }
+
+    uint32_t n_bands() {
+        return bands;
+    }
+
+    bool render(uint16_t codec, const uint8_t* data, uint32_t size, bool draw, DecodeStats* stats) {
+        ASSERT(bands != 0);
+
+        lock->lock();
+        job = Job{codec, data, size, draw};
+        if (bands == 1) {
+            render_band(0);
+        } else {
+            start->sync();
+            render_band(0);
+            finish->sync();
+        }
+
+        bool ok = true;
+        for (uint32_t b = 0; b < bands; b++) {
+            ok = ok && band[b].ok;
+            if (stats != nullptr) {
+                stats->fills += band[b].stats.fills;
+                stats->nodes += band[b].stats.nodes;
+            }
+        }
+        lock->unlock();
+        return ok;
+    }
+}
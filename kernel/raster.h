@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+struct DecodeStats;
+
+// Band-parallel frame renderer.
+//
+// The frame is cut into one horizontal band of scanlines per core. Each
+// band is decoded into the back buffer and, when a VBE mode is active,
+// scaled into the hidden VBE page by its own worker thread; the caller
+// renders band 0 itself. Two reusable barriers per frame hand out the
+// work and wait for all of it, so render() returns with the whole frame
+// drawn and nothing left running.
+//
+// Workers are ordinary kernel threads and idle cores steal ready threads
+// from busy ones, so bands are not pinned to cores; with one worker per
+// core they end up spread across them.
+namespace Raster {
+
+    // start the workers, called once by vga_init()
+    extern void init();
+
+    extern uint32_t n_bands();
+
+    // Decode a frame (see codec.h) into the back buffer, band by band in
+    // parallel. If "draw" is set and a VBE mode is active, also scale it
+    // into the hidden VBE page (the caller flips). Returns false if any
+    // band found the frame malformed.
+    extern bool render(uint16_t codec, const uint8_t* data, uint32_t size, bool draw, DecodeStats* stats = nullptr);
+}
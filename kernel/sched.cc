@@ -0,0 +1,63 @@
+#include "sched.h"
+#include "threads.h"
+#include "smp.h"
+#include "atomic.h"
+
+namespace Sched {
+
+    static Atomic<uint32_t> slice{DEFAULT_QUANTUM};
+    static PerCPU<Switches> counts;     // only touched with interrupts disabled
+
+    uint32_t quantum() {
+        return slice.get();
+    }
+
+    void set_quantum(uint32_t jiffies) {
+        slice.set(jiffies);
+    }
+
+    Switches switches() {
+        Switches out{0, 0};
+        for (uint32_t i = 0; i < kConfig.totalProcs; i++) {
+            auto& c = counts.forCPU(i);
+            out.voluntary += c.voluntary;
+            out.involuntary += c.involuntary;
+        }
+        return out;
+    }
+
+    void count_switch(bool voluntary) {
+        auto& c = counts.mine();
+        if (voluntary) {
+            c.voluntary += 1;
+        } else {
+            c.involuntary += 1;
+        }
+    }
+
+    void tick() {
+        using namespace impl::threads;
+
+        auto tcb = state.active_thread[SMP::me()];
+        if (tcb == nullptr) return;             // the helper is never preempted
+
+        // the helper has timers to fire, a thread that doesn't block
+        // mustn't keep them waiting for another core to go idle
+        const bool timer_due = state.timer_wheels[SMP::me()].due();
+        if (tcb->slice > 1 && !timer_due) {
+            tcb->slice -= 1;
+            return;
+        }
+
+        const uint32_t q = quantum();
+        if (!timer_due && (q == 0 || state.run_queues[SMP::me()].isEmpty())) {
+            // preemption is off or nobody else is waiting for this core
+            tcb->slice = q;
+            return;
+        }
+        state.block("preempt", [tcb] {
+            // Done in the helper thread
+            state.make_ready_here(tcb);
+        }, false);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+// Time slicing.
+//
+// A thread that is dispatched gets a slice of "quantum" jiffies. The APIC
+// tick on its core counts the slice down and, once it is used up and some
+// other thread is waiting for the core, moves the thread to the back of
+// the core's run queue through the core's helper thread, the same way a
+// blocking thread gets there (see State::block in threads.h). Code that
+// runs with interrupts disabled, spin locks included, and the helper
+// threads themselves are never preempted.
+//
+// Timers only fire in the helper threads (see timer_wheel.h), so a
+// thread that never blocks would hold back the timers on its core's
+// wheel. A tick that finds one of them due ends the slice right away,
+// even with a quantum of 0, so the helper runs the wheel and the threads
+// it wakes get the core.
+//
+// Every switch away from a thread is counted, per core: voluntary ones
+// (it blocked, yielded, slept or exited) and involuntary ones (its slice
+// ran out or a timer was due).
+namespace Sched {
+
+    constexpr uint32_t DEFAULT_QUANTUM = 10;    // jiffies
+    constexpr uint32_t MAX_QUANTUM = 1000;      // what user space may ask for
+
+    struct Switches {
+        uint32_t voluntary;
+        uint32_t involuntary;
+    };
+
+    // the slice in jiffies, 0 means no preemption
+    extern uint32_t quantum();
+
+    // takes effect for each thread the next time it is dispatched
+    extern void set_quantum(uint32_t jiffies);
+
+    // summed over the cores
+    extern Switches switches();
+
+    // called with interrupts disabled by whatever switches away from a thread
+    extern void count_switch(bool voluntary);
+
+    // called by the timer interrupt on every tick, after the EOI
+    extern void tick();
+}
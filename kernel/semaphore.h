@@ -42,7 +42,7 @@ public:
             if (n > 0) {             // O(1)
                 n = n - 1;           // O(1)
                 spin.unlock();
-                state.ready_queue.add(tcb);
+                state.make_ready(tcb);
             } else {
                 waiting.add(tcb);
                 spin.unlock();
@@ -59,7 +59,7 @@ public:
         }
         spin.unlock();
         if (wakeup != nullptr) {
-            state.ready_queue.add(wakeup);
+            state.make_ready(wakeup);
         }
     }
 };
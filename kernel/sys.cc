@@ -13,11 +13,31 @@
 #include "elf.h"
 #include "promise.h"
 #include "vga.h"
+#include "vbe.h"
+#include "textmode.h"
+#include "vga12.h"
+#include "modex.h"
+#include "palette.h"
+#include "codec.h"
+#include "sched.h"
+#include "video.h"
+#include "clock.h"
 
 bool address_valid(uint32_t addr, uint32_t size) {
     return addr >= 0x80000000 && addr + size <= 0xFFFFFFFF;
 }
 
+constexpr uint32_t PATH_MAX = 256;
+
+// every byte of a user string up to its NUL, at most PATH_MAX of them
+bool path_valid(const char* path) {
+    for (uint32_t i = 0; i < PATH_MAX; i++) {
+        if (!address_valid((uint32_t)(path + i), 1)) return false;
+        if (path[i] == 0) return true;
+    }
+    return false;
+}
+
 uint32_t read(uint32_t fd, void* buf, uint32_t nbyte) {
     if(!address_valid((uint32_t)buf, nbyte) || fd >= PCB_ARR_SIZE) {
         return -1;
@@ -111,7 +131,6 @@ uint32_t fork(uint32_t *frame) {
     auto parent_pcb = me->pcb;
     auto parent_pd = me->pd;
     auto parent_vme = me->vme;
-    auto parent_jiffies = me->at_jiffies;
 
     uint32_t pc = frame[0];
     uint32_t sp = frame[3];
@@ -127,9 +146,7 @@ uint32_t fork(uint32_t *frame) {
 
     // Debug::printf("HERE\n");
     
-    thread([parent_jiffies, pc, sp] {
-        auto me = impl::threads::state.current();
-        me->at_jiffies = parent_jiffies; // Jiffies  
+    thread([pc, sp] {
         // Debug::printf("GO TO PC: %x\n", pc);
         switchToUser(pc, sp, 0);
 
@@ -276,6 +293,149 @@ void vga_syscall() {
     vga_test();
 }
 
+// What vga_map() tells user space about the framebuffer it mapped
+struct VgaMode {
+    uint32_t width;
+    uint32_t height;
+    uint32_t bpp;
+    uint32_t pitch;     // bytes per row
+    uint32_t pages;     // pages to draw into, see vga_present()
+};
+
+// 320x200x8 is mode 13h, 80x25x0 text, 640x480x4 planar mode 12h,
+// 320x240x8 mode X, anything else is a VBE mode
+uint32_t vga_setmode_syscall(uint32_t width, uint32_t height, uint32_t bpp) {
+    if(width == VGA_WIDTH && height == VGA_HEIGHT && bpp == 8) {
+        if(VBE::width() != 0) VBE::disable();
+        vga_init();
+        return 0;
+    }
+    if(width == TEXT_COLS && height == TEXT_ROWS && bpp == 0) {
+        if(VBE::width() != 0) VBE::disable();
+        vga_init_text();
+        return 0;
+    }
+    if(width == VGA12_WIDTH && height == VGA12_HEIGHT && bpp == 4) {
+        if(VBE::width() != 0) VBE::disable();
+        vga_init_12h();
+        return 0;
+    }
+    if(width == MODEX_WIDTH && height == MODEX_HEIGHT && bpp == 8) {
+        if(VBE::width() != 0) VBE::disable();
+        vga_init_modex();
+        return 0;
+    }
+    if(!VBE::set_mode(width, height, bpp)) return -1;
+    Palette::init();    // 8 bit modes use the gray ramp too
+    return 0;
+}
+
+// Map the framebuffer of the current mode into the caller, returns its
+// address. Drawing is plain stores, no system call per pixel
+void* vga_map_syscall(VgaMode* mode) {
+    if(!address_valid((uint32_t)mode, sizeof(VgaMode))) return nullptr;
+    auto me = impl::threads::state.current();
+
+    uint32_t phys;
+    uint32_t size;
+    // mode X pages are spread over 4 planes, there is no linear view of them
+    if(VBE::width() == 0 && vga_display() == VGA_DISPLAY_MODEX) return nullptr;
+    if(VBE::width() != 0) {
+        *mode = VgaMode{VBE::width(), VBE::height(), VBE::bpp(), VBE::pitch(), 2};
+        phys = VBE::physical();
+        size = VBE::pitch() * VBE::height() * 2;
+    } else if(vga_display() == VGA_DISPLAY_12H) {
+        // every byte written lands in all 4 planes, 1 bit per pixel
+        *mode = VgaMode{VGA12_WIDTH, VGA12_HEIGHT, 1, VGA12_ROW_BYTES, 1};
+        phys = VGA_ADDRESS;
+        size = VGA12_ROW_BYTES * VGA12_HEIGHT;
+    } else if(vga_text_mode()) {
+        // character and attribute byte per cell
+        *mode = VgaMode{TEXT_COLS, TEXT_ROWS, 16, TEXT_COLS * 2, 1};
+        phys = TEXT_ADDRESS;
+        size = TEXT_COLS * TEXT_ROWS * 2;
+    } else {
+        *mode = VgaMode{VGA_WIDTH, VGA_HEIGHT, 8, VGA_WIDTH, 1};
+        phys = VGA_ADDRESS;
+        size = VGA_WIDTH * VGA_HEIGHT;
+    }
+    // one framebuffer mapping per process: calling again in the same mode
+    // gets the same one, after a mode change the old one goes away
+    auto old = me->vme->device_entry();
+    if(!(old == nullptr)) {
+        if(old->phys == phys && old->size == size) return (void*)old->start;
+        me->vme->remove_entry(old->start, true);
+    }
+    return (void*)me->vme->add_device_entry(size, phys, true);
+}
+
+// Show what was drawn since the last call. Returns the byte offset (from
+// the address vga_map returned) of the page to draw the next frame into
+uint32_t vga_present_syscall() {
+    if(VBE::width() != 0) {
+        VBE::flip();
+        return VBE::hidden_page() - (uint8_t*)VBE::LFB_VA;
+    }
+    // mode 13h draws straight to the screen, just keep the caller in step
+    // with the display
+    vga_wait_retrace();
+    return 0;
+}
+
+struct Timespec {
+    uint32_t sec;
+    uint32_t nsec;
+};
+
+// Sleep for at least "t", rounded up to whole jiffies (see sleep_us)
+uint32_t nanosleep(const Timespec* t) {
+    if(!address_valid((uint32_t)t, sizeof(Timespec))) return -1;
+    if(t->nsec >= 1000000000) return -1;
+    uint32_t sec = t->sec;
+    const uint32_t us = (t->nsec + 999) / 1000;
+    // whole seconds first, in chunks that fit in milliseconds
+    while(sec > 1000) {
+        sleep_ms(1000 * 1000);
+        sec -= 1000;
+    }
+    if(sec != 0) sleep_ms(sec * 1000);
+    sleep_us(us);
+    return 0;
+}
+
+// The time since boot, from the clocksource (see clock.h)
+uint32_t clock_gettime(Timespec* t) {
+    if(!address_valid((uint32_t)t, sizeof(Timespec))) return -1;
+    const uint64_t us = Clock::now_us();
+    t->sec = uint32_t(us / 1000000);
+    t->nsec = uint32_t(us % 1000000) * 1000;
+    return 0;
+}
+
+struct SchedStats {
+    uint32_t quantum;
+    uint32_t voluntary;
+    uint32_t involuntary;
+};
+
+uint32_t sched_stats(SchedStats* stats) {
+    if(!address_valid((uint32_t)stats, sizeof(SchedStats))) return -1;
+    auto switches = Sched::switches();
+    *stats = SchedStats{Sched::quantum(), switches.voluntary, switches.involuntary};
+    return 0;
+}
+
+uint32_t video_open(const char* path) {
+    if(!path_valid(path)) return -1;
+    return Video::open(path) ? 0 : -1;
+}
+
+uint32_t video_status(Video::Status* status) {
+    if(!address_valid((uint32_t)status, sizeof(Video::Status))) return -1;
+    *status = Video::status();
+    return 0;
+}
+
 extern "C" int sysHandler(uint32_t eax, uint32_t *frame) {
     //Debug::printf("*** syscall #%d\n",eax);
     uint32_t *user_sp = (uint32_t*)frame[3];
@@ -325,6 +485,40 @@ extern "C" int sysHandler(uint32_t eax, uint32_t *frame) {
         Debug::printf("*** about to run vga test\n");
         vga_test();
         return 0;
+    case 104:
+        return vga_setmode_syscall(user_sp[1], user_sp[2], user_sp[3]);
+    case 105:
+        return (uint32_t)vga_map_syscall((VgaMode*)user_sp[1]);
+    case 106:
+        return vga_present_syscall();
+    case 107:
+        return video_open((const char*)user_sp[1]);
+    case 108:
+        Video::play();
+        return 0;
+    case 109:
+        Video::pause();
+        return 0;
+    case 110:
+        Video::seek(user_sp[1]);
+        return 0;
+    case 111:
+        return video_status((Video::Status*)user_sp[1]);
+    case 112:
+        set_gray_dither(user_sp[1] != 0);
+        return 0;
+    case 113:
+        return nanosleep((const Timespec*)user_sp[1]);
+    case 116:
+        return clock_gettime((Timespec*)user_sp[1]);
+    case 114:
+        // the quantum is shared by every process, don't let one turn
+        // preemption off (0) or as good as off for everyone else
+        if(user_sp[1] == 0 || user_sp[1] > Sched::MAX_QUANTUM) return -1;
+        Sched::set_quantum(user_sp[1]);
+        return 0;
+    case 115:
+        return sched_stats((SchedStats*)user_sp[1]);
     case 418:
         Debug::printf("*** I'm a teapot\n");
         return -1;
@@ -0,0 +1,121 @@
+#include "textmode.h"
+#include "machine.h"
+
+namespace {
+
+    constexpr uint8_t HALF_BLOCK = 0xDF;        // upper half block
+    constexpr uint32_t GLYPH_BYTES = 32;        // font slots are 32 lines apart
+    constexpr uint32_t GLYPH_LINES = 16;
+    constexpr uint32_t CELLS = TEXT_COLS * TEXT_ROWS;
+
+    constexpr uint32_t BLOCK_W = VGA_WIDTH / TEXT_COLS;            // 4
+    constexpr uint32_t BLOCK_H = VGA_HEIGHT / (2 * TEXT_ROWS);     // 4
+    static_assert(BLOCK_W * TEXT_COLS == VGA_WIDTH && 2 * BLOCK_H * TEXT_ROWS == VGA_HEIGHT);
+
+    // what is on the screen, so only changed cells get written
+    uint16_t shown[CELLS];
+
+    inline volatile uint16_t* cells() {
+        return (volatile uint16_t*) TEXT_ADDRESS;
+    }
+
+    uint8_t read_reg(int index_port, uint8_t index) {
+        outb(index_port, index);
+        return inb(index_port + 1);
+    }
+
+    void write_reg(int index_port, uint8_t index, uint8_t value) {
+        outb(index_port, index);
+        outb(index_port + 1, value);
+    }
+
+    // Mode 13h leaves plane 2, where the font lives, full of pixels. We
+    // only need one glyph, so write that instead of carrying a whole font.
+    void load_glyph() {
+        const uint8_t seq2 = read_reg(VGA_SEQ_INDEX, 2);
+        const uint8_t seq4 = read_reg(VGA_SEQ_INDEX, 4);
+        const uint8_t gc4 = read_reg(VGA_GC_INDEX, 4);
+        const uint8_t gc5 = read_reg(VGA_GC_INDEX, 5);
+        const uint8_t gc6 = read_reg(VGA_GC_INDEX, 6);
+
+        // flat addressing, plane 2 only
+        write_reg(VGA_SEQ_INDEX, 4, seq4 | 0x04);
+        write_reg(VGA_GC_INDEX, 5, gc5 & ~0x10);
+        write_reg(VGA_GC_INDEX, 6, gc6 & ~0x02);
+        write_reg(VGA_GC_INDEX, 4, 2);
+        write_reg(VGA_SEQ_INDEX, 2, 1 << 2);
+
+        auto glyph = (volatile uint8_t*) TEXT_ADDRESS + HALF_BLOCK * GLYPH_BYTES;
+        for (uint32_t line = 0; line < GLYPH_LINES; line++) {
+            glyph[line] = (line < GLYPH_LINES / 2) ? 0xFF : 0x00;
+        }
+
+        write_reg(VGA_SEQ_INDEX, 2, seq2);
+        write_reg(VGA_SEQ_INDEX, 4, seq4);
+        write_reg(VGA_GC_INDEX, 4, gc4);
+        write_reg(VGA_GC_INDEX, 5, gc5);
+        write_reg(VGA_GC_INDEX, 6, gc6);
+    }
+
+    // a palette index as one of the 16 text colors, gray ramp levels
+    // become black, dark gray, light gray or white
+    inline uint8_t text_color(uint8_t c) {
+        if (c < VGA_GRAY_BASE) return c & 0x0F;
+        if (c >= VGA_GRAY_BASE + VGA_GRAY_LEVELS) return c & 0x0F;
+        constexpr uint8_t grays[4] = {0x0, 0x8, 0x7, 0xF};
+        return grays[(c - VGA_GRAY_BASE) * 4 / VGA_GRAY_LEVELS];
+    }
+
+    // the color of one 4x4 block
+    inline uint8_t block_color(const uint8_t* p) {
+        uint8_t counts[16] = {};
+        for (uint32_t y = 0; y < BLOCK_H; y++) {
+            for (uint32_t x = 0; x < BLOCK_W; x++) {
+                counts[text_color(p[y * VGA_WIDTH + x])] += 1;
+            }
+        }
+        if (2 * counts[0] > BLOCK_W * BLOCK_H) return 0;
+
+        // ties go to the lower color
+        uint8_t color = 1;
+        for (uint8_t c = 2; c < 16; c++) {
+            if (counts[c] > counts[color]) color = c;
+        }
+        return color;
+    }
+}
+
+void text_init() {
+    write_regs(g_80x25_text);
+    load_glyph();
+
+    // a black space everywhere
+    for (uint32_t i = 0; i < CELLS; i++) {
+        shown[i] = 0x0020;
+        cells()[i] = shown[i];
+    }
+    // hide the cursor
+    write_reg(VGA_CRTC_INDEX, 0x0A, 0x20);
+}
+
+PresentStats text_present(const uint8_t* pixels) {
+    PresentStats stats{};
+    for (uint32_t row = 0; row < TEXT_ROWS; row++) {
+        auto top = pixels + row * 2 * BLOCK_H * VGA_WIDTH;
+        auto bottom = top + BLOCK_H * VGA_WIDTH;
+        for (uint32_t col = 0; col < TEXT_COLS; col++) {
+            const uint8_t fg = block_color(top + col * BLOCK_W);
+            const uint8_t bg = block_color(bottom + col * BLOCK_W) & 0x07;
+            const uint16_t cell = uint16_t(((bg << 4) | fg) << 8) | HALF_BLOCK;
+
+            const uint32_t i = row * TEXT_COLS + col;
+            if (shown[i] != cell) {
+                shown[i] = cell;
+                cells()[i] = cell;
+                stats.tiles_changed += 1;
+                stats.bytes_written += sizeof(cell);
+            }
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include "vga.h"
+
+// 80x25 text mode as a 80x50 pixel display.
+//
+// Every character cell shows the upper half block (CP437 0xDF) with the
+// top pixel as the foreground color and the bottom pixel as the
+// background color. A frame is at most 4000 bytes of VGA writes instead
+// of 64000, and text_present() only rewrites the cells that changed, which
+// makes it a cheap fallback when the host's VGA emulation is slow.
+//
+// Each pixel stands for a 4x4 block of the VGA_WIDTH x VGA_HEIGHT frame,
+// colored with its most common non-black color if at least half of the
+// block is not black. Backgrounds only have 8 colors, a bottom pixel loses
+// the bright bit.
+
+#define TEXT_ADDRESS 0xB8000
+#define TEXT_COLS 80
+#define TEXT_ROWS 25
+
+// switch to 80x25 text, load the half block glyph and clear the screen
+void text_init();
+
+// show a VGA_WIDTH x VGA_HEIGHT buffer of palette indices
+PresentStats text_present(const uint8_t* pixels);
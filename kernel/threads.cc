@@ -8,6 +8,8 @@
 #include "blocking_queue.h"
 #include "vmm.h"
 #include "tss.h"
+#include "clock.h"
+#include "machine.h"
 
 namespace impl::threads {
 
@@ -24,6 +26,10 @@ namespace impl::threads {
 
         reaper_queue = new BlockingQueue<TCB>();
 
+        for (uint32_t id = 0; id < kConfig.totalProcs; id++) {
+            timer_wheels[id].init(id);
+        }
+
         // The reaper thread, needs to run in a thread in order to
         // be able to access the heap and contend for the queue
         thread([this] {
@@ -50,35 +56,26 @@ namespace impl::threads {
         }
     }
 
-    void SleepQueue::add(TCB* tcb, uint32_t after_seconds) {
-        ASSERT(tcb != nullptr);                    // must have a TCB
-        ASSERT(state.in_helper_thread());    // can only run with preemption disabled
-
-        TCB** pprev = &first;
-        TCB* p = first;
-
-        tcb->at_jiffies = Pit::jiffies + Pit::secondsToJiffies(after_seconds);
-
-        while ((p != nullptr) && (p->at_jiffies <= tcb->at_jiffies)) {
-            pprev = &p->next;
-            p = p->next;
+    TCB* State::next_ready(uint32_t id) {
+        auto tcb = run_queues[id].remove();
+        if (tcb != nullptr) return tcb;
+
+        // steal from the busiest peer
+        uint32_t victim = id;
+        uint32_t most = 0;
+        for (uint32_t i = 0; i < kConfig.totalProcs; i++) {
+            auto n = run_queues[i].n.get();
+            if (i != id && n > most) {
+                most = n;
+                victim = i;
+            }
         }
-
-        tcb->next = *pprev;
-        *pprev = tcb;
+        return (victim == id) ? nullptr : run_queues[victim].remove();
     }
 
-    TCB* SleepQueue::remove() {
-        ASSERT(state.in_helper_thread()); // can only run in the helper thread with preemption disabled
-        auto p = first;
-
-        if ((p == nullptr) || (p->at_jiffies > Pit::jiffies)) {
-            return nullptr;
-        } else {
-            first = p->next;
-            p->next = nullptr;
-            return p;
-        }
+    // a sleeping thread's timer went off
+    static void wake(Timer* timer) {
+        state.make_ready((TCB*) timer->arg);
     }
 
     [[noreturn]]
@@ -98,10 +95,14 @@ namespace impl::threads {
         ASSERT(state.in_helper_thread());
 
         auto wakeup = [id] {
-            auto p = state.sleep_queues[id].remove();
-            while (p != nullptr) {
-                state.ready_queue.add(p);
-                p = state.sleep_queues[id].remove();
+            state.timer_wheels[id].run();
+        };
+
+        // nothing to run here, the other cores may be too busy to look
+        // at their wheels
+        auto wakeup_all = [] {
+            for (uint32_t other = 0; other < kConfig.totalProcs; other++) {
+                state.timer_wheels[other].run();
             }
         };
 
@@ -119,15 +120,28 @@ namespace impl::threads {
                 request->doit();
             }
 
-            TCB* next = state.ready_queue.remove();
+            TCB* next = state.next_ready(id);
             while (next == nullptr) {
                 iAmStuckInALoop(false);
-                wakeup();
-                next = state.ready_queue.remove();
+                wakeup_all();
+                next = state.next_ready(id);
+                if (next == nullptr) {
+                    // sleep until the first timer on any wheel, see wakeup_all
+                    uint32_t at = Pit::jiffies + 0x7FFFFFFF;
+                    for (uint32_t other = 0; other < kConfig.totalProcs; other++) {
+                        auto t = state.timer_wheels[other].next_expiry();
+                        if (int32_t(t - at) < 0) at = t;
+                    }
+                    Pit::idle(at, [] {
+                        return state.any_ready();
+                    });
+                }
             }
 
             // setting active_thread enables preemption, need to disable interrupts briefly
             cli();     
+            next->slice = Sched::quantum();                         // O(1)
+            next->last_core = id;                                   // O(1)
             state.active_thread[id] = next;                         // O(1)
 	    tss[id].esp0 = next->interruptEsp();                    // O(1)
             context_switch(&state.helpers[id], &next->save_area);   // O(1)
@@ -141,30 +155,75 @@ using namespace impl::threads;
 void yield() {
     // Performance optimization. In the worse case, the data race will
     // cause us to miss a ready thread once but will find it when we
-    // check again.
+    // check again. Only this core's queue matters: make_ready_here puts
+    // us at its back, so with it empty we'd be picked again right away
     reap();
 
-    if (state.ready_queue.isEmpty()) return;
-
+    if (state.run_queues[SMP::me()].isEmpty()) return;
 
     auto tcb = state.current();
     ASSERT(tcb != nullptr);
     state.block("yield", [tcb] {
         // run in the helper thread
-        state.ready_queue.add(tcb);
+        state.make_ready_here(tcb);
     });
 }
 
+void add_timer(Timer* timer, uint32_t at_jiffies) {
+    // the core could change under us, any wheel will do
+    state.timer_wheels[SMP::me()].add(timer, at_jiffies);
+}
+
+bool cancel_timer(Timer* timer) {
+    while (true) {
+        auto id = timer->wheel.get();
+        if (id < 0) return false;
+        if (state.timer_wheels[id].cancel(timer)) return true;
+        // it moved between the read and the lock, look again
+    }
+}
+
 void sleep(uint32_t sec) {
+    sleep_until(Pit::jiffies + Pit::secondsToJiffies(sec));
+}
+
+void sleep_until(uint32_t at_jiffies) {
     reap();
+    if (int32_t(Pit::jiffies - at_jiffies) >= 0) return;
     auto tcb = state.current();
     ASSERT(tcb != nullptr);
-    state.block("sleep",[tcb, sec] {
+    state.block("sleep_until",[tcb, at_jiffies] {
         // run in helper thread with preemption disabled
-        state.sleep_queues[SMP::me()].add(tcb, sec);
+        tcb->sleep_timer.fire = wake;
+        tcb->sleep_timer.arg = tcb;
+        add_timer(&tcb->sleep_timer, at_jiffies);
     });
 }
 
+static void sleep_for(uint64_t us) {
+    const uint64_t deadline = Clock::now_us() + us;
+
+    // The wheel only wakes us on a jiffy, so round up to whole jiffies:
+    // even a 1 us sleep gives the core up. sleep_until(jiffies + n) can
+    // return up to a jiffy early, so top up a jiffy at a time until the
+    // deadline has passed
+    const uint32_t us_per_jiffy = 1000000 / Pit::secondsToJiffies(1);
+    const uint32_t n = uint32_t((us + us_per_jiffy - 1) / us_per_jiffy);
+    if (n > 0) sleep_until(Pit::jiffies + n);
+
+    while (Clock::now_us() < deadline) {
+        sleep_until(Pit::jiffies + 1);
+    }
+}
+
+void sleep_ms(uint32_t ms) {
+    sleep_for(uint64_t(ms) * 1000);
+}
+
+void sleep_us(uint32_t us) {
+    sleep_for(us);
+}
+
 [[noreturn]]
 void stop() {
     auto tcb = state.current();
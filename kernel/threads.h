@@ -8,6 +8,9 @@
 #include "vme.h"
 #include "vmm.h"
 #include "processes.h"
+#include "timer_wheel.h"
+#include "pit.h"
+#include "sched.h"
 
 constexpr size_t STACK_BYTES = 8 * 1024;
 constexpr size_t STACK_WORDS = STACK_BYTES / sizeof(uintptr_t);  /* sizeof(word) == size(void*) */
@@ -29,7 +32,9 @@ namespace impl::threads {
     // Abstract base class for thread control blocks
     struct TCB {
         TCB* next = nullptr;        // for adding to queues, invariant: a TCB can belong to at most one queue
-        uint32_t at_jiffies = 0;    // when to wakeup, only used by sleeping threads
+        Timer sleep_timer{};        // wakes the thread up, only used by sleeping threads
+        uint32_t slice = 0;         // jiffies left before it can be preempted, see sched.h
+        uint32_t last_core = 0;     // where it last ran (or was created), its caches are warm there
         SaveArea save_area{};       // the save area
         StrongPtr<VME<NoLock>> vme;
         uint32_t pd;
@@ -127,22 +132,29 @@ namespace impl::threads {
         }
     };
 
-    // SleepQueue, a linked list of TCBs representing sleeping threads
-    // ordered by wakeup time.
-    // Having O(n) add implies that a sleep queue can't be protected by
-    // a spin lock.
-    // Needing to access it from helper threads means that it can't be
-    // protected by a blocking lock.
-    // The only choice we're left with is to make it per-core.
-    class SleepQueue {
-        impl::threads::TCB* first = nullptr;
-    public:
-        // Add a TCB to the list, O(n)
-        void add(impl::threads::TCB* tcb, uint32_t after_seconds);
-        // remove the next eligible TCB (the earliest one whose time has come, if any)
-        // from the list.
-        // O(1)
-        impl::threads::TCB* remove();
+    // A core's share of the ready threads. Its owner pushes and pops
+    // locally, other cores only touch it to steal when they have nothing
+    // to run, so the locks are rarely contended. "n" is a hint for
+    // choosing whom to steal from and for cheap emptiness checks.
+    struct RunQueue {
+        Queue<TCB, SpinLock> queue{};
+        Atomic<uint32_t> n{0};
+        char pad[64]{};                 // keep neighbours off each other's cache line
+
+        void add(TCB* tcb) {
+            queue.add(tcb);
+            n.add_fetch(1);
+        }
+
+        TCB* remove() {
+            auto tcb = queue.remove();
+            if (tcb != nullptr) n.add_fetch(-1);
+            return tcb;
+        }
+
+        bool isEmpty() {
+            return n.get() == 0;
+        }
     };
 
     // Forward declaration in order to avoid circular references
@@ -153,12 +165,37 @@ namespace impl::threads {
         Request **help_requests = new Request*[kConfig.totalProcs]();    // An array of off-level requests, one per core
         SaveArea *helpers = new SaveArea[kConfig.totalProcs]();          // The saved state of the helpers, one per core
         TCB** active_thread = new TCB*[kConfig.totalProcs]();            // active threads, one per core
-        SleepQueue *sleep_queues = new SleepQueue[kConfig.totalProcs](); // sleep queues (sorted by wakeup time), one per core
-        Queue<TCB, SpinLock> ready_queue{};   // the ready queue, one per system
+        TimerWheel *timer_wheels = new TimerWheel[kConfig.totalProcs](); // pending timers (sleeping threads, ...), one per core
+        RunQueue *run_queues = new RunQueue[kConfig.totalProcs]();       // ready threads, one queue per core
         BlockingQueue<TCB>* reaper_queue;  // the reaper queue, one per system
 
         State();
 
+        // Queue on the core it last ran on and wake that core if it is
+        // idle, or some idle core to steal it if that one is busy
+        void make_ready(TCB* tcb) {
+            auto core = tcb->last_core;
+            run_queues[core].add(tcb);
+            Pit::kick(core);
+        }
+
+        // queue on this core, the thread is going to run here again
+        void make_ready_here(TCB* tcb) {
+            run_queues[SMP::me()].add(tcb);
+        }
+
+        // the next thread for core "id", stolen from the busiest other
+        // core if there is none of its own
+        TCB* next_ready(uint32_t id);
+
+        // some thread is ready somewhere, racy
+        bool any_ready() {
+            for (uint32_t i = 0; i < kConfig.totalProcs; i++) {
+                if (!run_queues[i].isEmpty()) return true;
+            }
+            return false;
+        }
+
         bool in_helper_thread() {
             return current() == nullptr;
         }
@@ -176,9 +213,9 @@ namespace impl::threads {
             return tcb;
         }
 
-        // O(1)
+        // O(1), "voluntary" is false when the thread is being preempted
         template <typename Work>
-        void block(const char* from, Work w) {
+        void block(const char* from, Work w, bool voluntary = true) {
             static_assert(sizeof(w) < 200);      // will be wrapped in a lambda that lives on the stack
                                                  // size will be checked at compile time
 
@@ -186,6 +223,7 @@ namespace impl::threads {
             auto id = SMP::me();                    // O(1)
             auto tcb = active_thread[id];           // O(1)
             active_thread[id] = nullptr;            // O(1) prevents preemption
+            Sched::count_switch(voluntary);         // O(1)
             Interrupts::restore(was);               // O(1)
 
             ASSERT(id < MAX_PROCS);
@@ -208,6 +246,27 @@ namespace impl::threads {
 extern void stop();
 extern void yield();
 extern void sleep(uint32_t seconds);
+// sleep until Pit::jiffies >= at_jiffies, returns immediately if that time has passed
+extern void sleep_until(uint32_t at_jiffies);
+// Sleep for at least this long, on the timer wheel. The wakeup comes on
+// the first jiffy past the deadline, so sleeps are rounded up to whole
+// jiffies
+extern void sleep_ms(uint32_t ms);
+extern void sleep_us(uint32_t us);
+
+// Arm "timer" (with its "fire" and "arg" set) on this core's wheel, it
+// fires in a helper thread once Pit::jiffies reaches "at_jiffies". O(1)
+extern void add_timer(Timer* timer, uint32_t at_jiffies);
+// Disarm it wherever it is, false if it already fired (or is firing). O(1)
+extern bool cancel_timer(Timer* timer);
+
+namespace impl::threads {
+    // new threads start out queued on the core that creates them (core 0
+    // for the ones created before the APICs are up)
+    inline uint32_t creating_core() {
+        return (SMP::running.get() == 0) ? 0 : SMP::me();
+    }
+}
 
 template <typename T>
 void thread(T const& f) {
@@ -215,7 +274,8 @@ void thread(T const& f) {
 
     reap();
     auto tcb = new TCBWithWork(f, VMM::new_page_directory(), StrongPtr<PCB>::make(1), StrongPtr<VME<NoLock>>::make(0x80000000, 0xF0000000));
-    state.ready_queue.add(tcb);
+    tcb->last_core = creating_core();
+    state.make_ready(tcb);
 }
 
 template <typename T>
@@ -224,6 +284,7 @@ void thread(T const& f, uint32_t pd, StrongPtr<PCB> pcb, StrongPtr<VME<NoLock>>
 
     reap();
     auto tcb = new TCBWithWork(f, pd, pcb, vme);
-    state.ready_queue.add(tcb);
+    tcb->last_core = creating_core();
+    state.make_ready(tcb);
 }
 
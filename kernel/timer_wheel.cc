@@ -0,0 +1,133 @@
+#include "timer_wheel.h"
+#include "pit.h"
+#include "debug.h"
+#include "libk.h"
+
+void TimerWheel::link(Timer* t) {
+    int32_t delta = int32_t(t->expires - now);
+    if (delta < 0) delta = 0;       // overdue, goes in the slot run() looks at next
+    const uint32_t due = now + K::min(uint32_t(delta), SPAN - 1);   // far ones get moved down again
+
+    uint32_t level = 0;
+    while (level < LEVELS - 1 && uint32_t(delta) >= (1u << ((level + 1) * BITS))) {
+        level += 1;
+    }
+    auto& head = slots[level][(due >> (level * BITS)) & MASK];
+
+    t->pprev = &head;
+    t->next = head;
+    if (head != nullptr) head->pprev = &t->next;
+    head = t;
+}
+
+void TimerWheel::unlink(Timer* t) {
+    *t->pprev = t->next;
+    if (t->next != nullptr) t->next->pprev = t->pprev;
+    t->next = nullptr;
+    t->pprev = nullptr;
+}
+
+// spread the current slot of "level" over the levels below
+void TimerWheel::cascade(uint32_t level) {
+    auto& head = slots[level][(now >> (level * BITS)) & MASK];
+    Timer* t = head;
+    head = nullptr;
+    while (t != nullptr) {
+        auto next = t->next;
+        link(t);
+        t = next;
+    }
+}
+
+void TimerWheel::add(Timer* t, uint32_t at_jiffies) {
+    lock.lock();
+    ASSERT(t->wheel.get() == -1);
+    t->expires = at_jiffies;
+    if (pending == 0) now = Pit::jiffies;   // nothing to catch up on
+    link(t);
+    t->wheel.set(id);
+    pending += 1;
+    lock.unlock();
+}
+
+bool TimerWheel::cancel(Timer* t) {
+    lock.lock();
+    const bool mine = t->wheel.get() == id;
+    if (mine) {
+        unlink(t);
+        t->wheel.set(-1);
+        pending -= 1;
+    }
+    lock.unlock();
+    return mine;
+}
+
+uint32_t TimerWheel::next_expiry() {
+    if (pending == 0) return Pit::jiffies + 0x7FFFFFFF;
+
+    lock.lock();
+    // the next non empty level 0 slot, or the next time level 0 wraps
+    // and level 1 comes down
+    uint32_t at = (now | MASK) + 1;
+    for (uint32_t i = 0; i < SLOTS; i++) {
+        if (int32_t((now + i) - at) >= 0) break;
+        if (slots[0][(now + i) & MASK] != nullptr) {
+            at = now + i;
+            break;
+        }
+    }
+    lock.unlock();
+    return at;
+}
+
+bool TimerWheel::due() {
+    return pending != 0 && int32_t(Pit::jiffies - next_expiry()) >= 0;
+}
+
+void TimerWheel::run() {
+    // a racy peek, saves taking the lock when there is nothing to do
+    if (pending == 0 || int32_t(Pit::jiffies - now) < 0) return;
+
+    // collect what is due under the lock, fire it after
+    Timer* due = nullptr;
+    lock.lock();
+    const uint32_t until = Pit::jiffies;
+    while (pending != 0 && int32_t(until - now) >= 0) {
+        // when level 0 wraps around bring the next level 1 slot down, and
+        // the next level 2 slot before that if level 1 wraps too, ...
+        uint32_t top = 0;
+        while (top + 1 < LEVELS && ((now >> (top * BITS)) & MASK) == 0) {
+            top += 1;
+        }
+        for (uint32_t level = top; level > 0; level--) {
+            cascade(level);
+        }
+
+        auto& head = slots[0][now & MASK];
+        Timer* t = head;
+        head = nullptr;
+        while (t != nullptr) {
+            auto next = t->next;
+            if (int32_t(t->expires - now) > 0) {
+                link(t);        // was further out than the wheel reaches
+            } else {
+                t->wheel.set(-1);
+                pending -= 1;
+                t->pprev = nullptr;
+                t->next = due;
+                due = t;
+            }
+            t = next;
+        }
+        now += 1;
+    }
+    if (pending == 0) now = until + 1;
+    lock.unlock();
+
+    while (due != nullptr) {
+        auto next = due->next;
+        due->next = nullptr;
+        due->fire(due);
+        due = next;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include "atomic.h"
+
+// A pending timeout. The owner keeps it wherever it likes (every TCB
+// embeds one for sleeping), the wheel links it in place, so adding and
+// cancelling never allocate.
+struct Timer {
+    Timer* next = nullptr;
+    Timer** pprev = nullptr;        // what points at this timer, for O(1) unlinking
+    uint32_t expires = 0;           // the Pit::jiffies at which it fires
+    Atomic<int32_t> wheel{-1};      // the core whose wheel holds it, -1 if not pending
+    void (*fire)(Timer*) = nullptr; // runs in a helper thread, must be O(1) and never block
+    void* arg = nullptr;
+};
+
+// Hierarchical timing wheel, one per core.
+//
+// LEVELS wheels of SLOTS doubly linked lists each. A timer due within
+// SLOTS jiffies sits in the level 0 slot for its jiffy, one due within
+// SLOTS^2 in the level 1 slot for its block of SLOTS jiffies, and so on.
+// Each time level 0 wraps around, the next level 1 slot is spread out
+// over level 0 (and level 2 over level 1 when that wraps, ...), so every
+// timer is moved at most LEVELS - 1 times before it fires.
+//
+// add() and cancel() are O(1) and any core can call them on any wheel,
+// each wheel has its own spin lock. run() fires whatever is due on one
+// wheel, the helper threads call it for their own core and, when idle,
+// for the others too so a core that is busy doesn't hold up its timers.
+class TimerWheel {
+    static constexpr uint32_t LEVELS = 4;
+    static constexpr uint32_t BITS = 6;
+    static constexpr uint32_t SLOTS = 1 << BITS;
+    static constexpr uint32_t MASK = SLOTS - 1;
+    static constexpr uint32_t SPAN = 1 << (LEVELS * BITS);   // jiffies the wheel covers
+
+    SpinLock lock{};
+    int32_t id = -1;
+    uint32_t now = 0;               // the next jiffy run() handles
+    uint32_t pending = 0;
+    Timer* slots[LEVELS][SLOTS]{};
+
+    void link(Timer* t);
+    void unlink(Timer* t);
+    void cascade(uint32_t level);
+
+public:
+    void init(int32_t id) { this->id = id; }
+
+    // fire "t" once Pit::jiffies reaches "at_jiffies" (at the next run()
+    // if that has passed), "t" must not be pending
+    void add(Timer* t, uint32_t at_jiffies);
+
+    // take "t" off the wheel, false if it isn't on this one (any more)
+    bool cancel(Timer* t);
+
+    // fire every timer that is due
+    void run();
+
+    // No timer fires before this jiffy (far away if there are none).
+    // Timers on the upper levels count as due when their slot comes down,
+    // so this can be early but never late
+    uint32_t next_expiry();
+
+    // whether run() may have something to fire, lock free when the wheel
+    // is empty
+    bool due();
+};
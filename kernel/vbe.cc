@@ -0,0 +1,205 @@
+#include "vbe.h"
+#include "vga.h"
+#include "machine.h"
+#include "debug.h"
+#include "libk.h"
+#include "blit.h"
+
+namespace VBE {
+
+    constexpr int INDEX_PORT = 0x1CE;
+    constexpr int DATA_PORT = 0x1CF;
+
+    // dispi registers
+    constexpr uint32_t REG_ID = 0;
+    constexpr uint32_t REG_XRES = 1;
+    constexpr uint32_t REG_YRES = 2;
+    constexpr uint32_t REG_BPP = 3;
+    constexpr uint32_t REG_ENABLE = 4;
+    constexpr uint32_t REG_VIRT_WIDTH = 6;
+    constexpr uint32_t REG_VIRT_HEIGHT = 7;
+    constexpr uint32_t REG_Y_OFFSET = 9;
+
+    constexpr uint32_t ENABLED = 0x01;
+    constexpr uint32_t LFB_ENABLED = 0x40;
+
+    constexpr uint32_t ID_MIN = 0xB0C0;
+    constexpr uint32_t ID_MAX = 0xB0C5;
+
+    constexpr uint32_t PCI_VENDOR = 0x1234;
+    constexpr uint32_t PCI_DEVICE = 0x1111;
+
+    // plain data, lfb_physical() runs before global constructors
+    static bool mapped = false;
+    static uint32_t lfb = 0;
+    static uint32_t cur_width = 0;
+    static uint32_t cur_height = 0;
+    static uint32_t cur_bpp = 0;
+    static uint32_t shown = 0;          // which page is on the screen
+
+    // the 16 EGA colors, anything else is shown as gray
+    static const uint32_t ega[16] = {
+        0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+        0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF,
+    };
+
+    // a palette index as 0xRRGGBB, direct color modes have no DAC
+    static inline uint32_t rgb(uint8_t c) {
+        if (c < 16) return ega[c];
+        if (c >= VGA_GRAY_BASE && c < VGA_GRAY_BASE + VGA_GRAY_LEVELS) {
+            return ((c - VGA_GRAY_BASE) * 255 / (VGA_GRAY_LEVELS - 1)) * 0x010101;
+        }
+        return 0x808080;
+    }
+
+    static void write_reg(uint32_t index, uint32_t value) {
+        outw(INDEX_PORT, index);
+        outw(DATA_PORT, value);
+    }
+
+    static uint32_t read_reg(uint32_t index) {
+        outw(INDEX_PORT, index);
+        return inw(DATA_PORT);
+    }
+
+    static uint32_t pci_read(uint32_t bus, uint32_t dev, uint32_t func, uint32_t offset) {
+        outl(0xCF8, 0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | (offset & 0xFC));
+        return inl(0xCFC);
+    }
+
+    uint32_t lfb_physical() {
+        auto id = read_reg(REG_ID);
+        if (id < ID_MIN || id > ID_MAX) return 0;
+
+        for (uint32_t dev = 0; dev < 32; dev++) {
+            auto ids = pci_read(0, dev, 0, 0);
+            if ((ids & 0xFFFF) == PCI_VENDOR && (ids >> 16) == PCI_DEVICE) {
+                lfb = pci_read(0, dev, 0, 0x10) & ~0xF;   // BAR0, memory
+                return lfb;
+            }
+        }
+        return 0;
+    }
+
+    bool available() {
+        return mapped;
+    }
+
+    void set_mapped() {
+        mapped = true;
+    }
+
+    uint32_t physical() {
+        return lfb;
+    }
+
+    bool set_mode(uint32_t w, uint32_t h, uint32_t b) {
+        if (!mapped || (b != 8 && b != 32)) return false;
+        if (w == 0 || h == 0) return false;
+        // in 64 bits, user space picks w and h and 32 bits can wrap
+        if (uint64_t(w) * h * (b / 8) * 2 > LFB_BYTES) return false;
+
+        write_reg(REG_ENABLE, 0);
+        write_reg(REG_XRES, w);
+        write_reg(REG_YRES, h);
+        write_reg(REG_BPP, b);
+        write_reg(REG_VIRT_WIDTH, w);
+        write_reg(REG_VIRT_HEIGHT, 2 * h);
+        write_reg(REG_ENABLE, ENABLED | LFB_ENABLED);
+
+        if (read_reg(REG_XRES) != w || read_reg(REG_YRES) != h ||
+            read_reg(REG_BPP) != b || read_reg(REG_VIRT_HEIGHT) < 2 * h) {
+            Debug::printf("| VBE refused %dx%dx%d\n", w, h, b);
+            disable();
+            return false;
+        }
+
+        cur_width = w;
+        cur_height = h;
+        cur_bpp = b;
+        shown = 0;
+        write_reg(REG_Y_OFFSET, 0);
+        memset32((void*) LFB_VA, 0, pitch() * h * 2 / 4);
+        return true;
+    }
+
+    void disable() {
+        write_reg(REG_ENABLE, 0);
+        cur_width = cur_height = cur_bpp = 0;
+    }
+
+    uint32_t width() { return cur_width; }
+    uint32_t height() { return cur_height; }
+    uint32_t bpp() { return cur_bpp; }
+    uint32_t pitch() { return cur_width * cur_bpp / 8; }
+
+    uint32_t frame_bytes() {
+        uint32_t scale = K::max(K::min(cur_width / VGA_WIDTH, cur_height / VGA_HEIGHT), uint32_t(1));
+        return K::min(VGA_WIDTH * scale, cur_width) * K::min(VGA_HEIGHT * scale, cur_height) * (cur_bpp / 8);
+    }
+
+    uint8_t* hidden_page() {
+        return (uint8_t*) LFB_VA + (1 - shown) * pitch() * cur_height;
+    }
+
+    void flip() {
+        shown = 1 - shown;
+        write_reg(REG_Y_OFFSET, shown * cur_height);
+        // don't let anyone draw into the page we just left until the
+        // card has moved off it
+        vga_wait_retrace();
+    }
+
+    void draw_rows(const uint8_t* pixels, uint32_t y0, uint32_t y1) {
+        ASSERT(cur_width != 0);
+
+        uint32_t scale = K::min(cur_width / VGA_WIDTH, cur_height / VGA_HEIGHT);
+        if (scale == 0) scale = 1;
+        const uint32_t out_w = VGA_WIDTH * scale;
+        const uint32_t out_h = VGA_HEIGHT * scale;
+        const uint32_t left = (cur_width > out_w) ? (cur_width - out_w) / 2 : 0;
+        const uint32_t top = (cur_height > out_h) ? (cur_height - out_h) / 2 : 0;
+        const uint32_t bytes_pp = cur_bpp / 8;
+        const uint32_t visible_w = K::min(out_w, cur_width);
+        const uint32_t visible_h = K::min(out_h, cur_height);
+
+        auto page = hidden_page();
+
+        // the common case, the whole 8bpp image fits: let a specialized
+        // kernel do it
+        auto kernel = (bytes_pp == 1 && out_w <= cur_width && out_h <= cur_height) ?
+            blit_kernel(BLIT_8BPP, scale) : nullptr;
+        if (kernel != nullptr) {
+            if (y1 > y0) {
+                kernel(pixels + y0 * VGA_WIDTH, VGA_WIDTH, VGA_WIDTH, y1 - y0,
+                       page + (top + y0 * scale) * pitch() + left, pitch(), 0, 0);
+            }
+            return;
+        }
+
+        // build each scaled row once, then copy it "scale" times
+        for (uint32_t y = y0 * scale; y < y1 * scale && y < visible_h; y += scale) {
+            auto src = pixels + (y / scale) * VGA_WIDTH;
+            auto row = page + (top + y) * pitch() + left * bytes_pp;
+            if (bytes_pp == 1) {
+                for (uint32_t x = 0; x < visible_w; x++) {
+                    row[x] = src[x / scale];
+                }
+            } else {
+                auto row32 = (uint32_t*) row;
+                for (uint32_t x = 0; x < visible_w; x++) {
+                    auto c = src[x / scale];
+                    row32[x] = rgb(c);
+                }
+            }
+            for (uint32_t j = 1; j < scale && y + j < visible_h; j++) {
+                memcpy32(row + j * pitch(), row, visible_w * bytes_pp / 4);
+            }
+        }
+    }
+
+    void present(const uint8_t* pixels) {
+        draw_rows(pixels, 0, VGA_HEIGHT);
+        flip();
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+// Driver for the Bochs/QEMU VBE "dispi" interface (QEMU's -vga std).
+//
+// The card exposes its registers through an index/data port pair and its
+// video memory as a linear framebuffer (LFB) at PCI BAR0. The LFB is mapped
+// once, at VBE::LFB_VA in the shared region, by VMM::global_init so every
+// address space sees it and drawing is plain memory stores: no banking and
+// no port I/O per pixel.
+//
+// Modes are set with a virtual height of twice the visible height. The
+// card shows one half while we draw into the other, and flip() swaps them
+// by moving the Y offset during vertical retrace.
+namespace VBE {
+
+    // where the LFB lives in the shared region, and how much of it we map
+    constexpr uint32_t LFB_VA = 0xF0000000;
+    constexpr uint32_t LFB_BYTES = 8 * 1024 * 1024;
+
+    // Probe PCI for the card and return the physical address of the LFB,
+    // 0 if there is no such card. Called by VMM::global_init
+    extern uint32_t lfb_physical();
+
+    // true if lfb_physical() found the card and the LFB has been mapped
+    extern bool available();
+    extern void set_mapped();
+
+    // physical address of the LFB (page 0 then page 1), for mapping it
+    // into user space
+    extern uint32_t physical();
+
+    // Set a width x height mode at 8 or 32 bpp with 2 pages. Returns false
+    // if the card is missing, the mode doesn't fit in the mapped LFB, or
+    // the card refused it
+    extern bool set_mode(uint32_t width, uint32_t height, uint32_t bpp);
+
+    // switch back to legacy VGA (write_regs etc. work again)
+    extern void disable();
+
+    extern uint32_t width();
+    extern uint32_t height();
+    extern uint32_t bpp();
+    extern uint32_t pitch();    // bytes per row
+
+    // bytes present() writes per frame
+    extern uint32_t frame_bytes();
+
+    // the page that is not on the screen
+    extern uint8_t* hidden_page();
+
+    // show the hidden page, returns once the flip has taken effect
+    extern void flip();
+
+    // Scale source rows [y0, y1) of a VGA_WIDTH x VGA_HEIGHT buffer into
+    // the hidden page (see present). Disjoint row ranges touch disjoint
+    // parts of the page, so bands can be drawn in parallel
+    extern void draw_rows(const uint8_t* pixels, uint32_t y0, uint32_t y1);
+
+    // Scale a VGA_WIDTH x VGA_HEIGHT buffer of palette indices by the
+    // largest integer factor that fits, center it in the hidden page, then
+    // flip. In 32 bpp modes indices are translated with the default EGA
+    // colors.
+    extern void present(const uint8_t* pixels);
+}
@@ -2,6 +2,17 @@
 #include "machine.h"
 #include "threads.h"
 #include "debug.h"
+#include "frame.h"
+#include "codec.h"
+#include "video.h"
+#include "pacer.h"
+#include "raster.h"
+#include "blit.h"
+#include "vbe.h"
+#include "textmode.h"
+#include "palette.h"
+#include "vga12.h"
+#include "modex.h"
 
 #define COLOR_BLACK 0x0
 #define COLOR_GREEN 0x2
@@ -30,11 +41,88 @@ unsigned char g_320x200x256[] =
 	0x41, 0x00, 0x0F, 0x00,	0x00
 };
 
+// Mode X: unchained 320x240, mode 13h with chain-4 and doubleword mode off
+// and the vertical timing of mode 12h
+unsigned char g_320x240x256x[] =
+{
+/* MISC */
+	0xE3,
+/* SEQ */
+	0x03, 0x01, 0x0F, 0x00, 0x06,
+/* CRTC */
+	0x5F, 0x4F, 0x50, 0x82, 0x54, 0x80, 0x0D, 0x3E,
+	0x00, 0x41, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xEA, 0xAC, 0xDF, 0x28, 0x00, 0xE7, 0x06, 0xE3,
+	0xFF,
+/* GC */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x05, 0x0F,
+	0xFF,
+/* AC */
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+	0x41, 0x00, 0x0F, 0x00,	0x00
+};
+
+// Mode 12h, from the same modes.c as g_320x200x256
+unsigned char g_640x480x16[] =
+{
+/* MISC */
+	0xE3,
+/* SEQ */
+	0x03, 0x01, 0x08, 0x00, 0x06,
+/* CRTC */
+	0x5F, 0x4F, 0x50, 0x82, 0x54, 0x80, 0x0B, 0x3E,
+	0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xEA, 0x0C, 0xDF, 0x28, 0x00, 0xE7, 0x04, 0xE3,
+	0xFF,
+/* GC */
+	0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x05, 0x0F,
+	0xFF,
+/* AC */
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x14, 0x07,
+	0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+	0x01, 0x00, 0x0F, 0x00, 0x00
+};
+
+// 80x25 text (9 pixel wide, 16 line high characters), from the same
+// modes.c
+unsigned char g_80x25_text[] =
+{
+/* MISC */
+	0x67,
+/* SEQ */
+	0x03, 0x00, 0x03, 0x00, 0x02,
+/* CRTC */
+	0x5F, 0x4F, 0x50, 0x82, 0x55, 0x81, 0xBF, 0x1F,
+	0x00, 0x4F, 0x0D, 0x0E, 0x00, 0x00, 0x00, 0x50,
+	0x9C, 0x0E, 0x8F, 0x28, 0x1F, 0x96, 0xB9, 0xA3,
+	0xFF,
+/* GC */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x0E, 0x00,
+	0xFF,
+/* AC */
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x14, 0x07,
+	0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+	0x0C, 0x00, 0x0F, 0x08, 0x00
+};
+
+// Off-screen copy of the frame. All drawing primitives target this buffer
+// and vga_present() pushes it to VGA memory in one word-wide transfer, so
+// the (slow, uncached) aperture only sees VGA_WIDTH * VGA_HEIGHT / 4 stores
+// per frame and never shows a half drawn image.
+static unsigned char* back_buffer = nullptr;
+
+// What is currently on the screen. vga_present_dirty() compares the back
+// buffer against it tile by tile and only touches VGA memory for the tiles
+// that changed.
+static unsigned char* front_buffer = nullptr;
+
+// where frames go when there is no VBE mode
+static VgaDisplay display = VGA_DISPLAY_NONE;
+
 void draw_rectangle(int x, int y, int width, int height, unsigned short color) {
-	for (int i = 0; i < width; i++) {
-		for (int j = 0; j < height; j++) {
-			vga_plot_pixel(x+i, y+j, color);
-		}
+	for (int j = 0; j < height; j++) {
+		fill_run(back_buffer + (y+j) * VGA_WIDTH + x, width, color);
 	}
 }
 
@@ -59,38 +147,181 @@ void draw_happy_face(int x, int y) {
     Debug::printf("*** just drew a smiley face\n");
 }
 
-void vga_clear_screen() {
-    for (int i = 0; i < 320; i++) {
-        for (int j = 0; j < 200; j++) {
-            vga_plot_pixel(i,j,COLOR_BLACK);
-        }
+void vga_init() {
+    write_regs(g_320x200x256);
+    display = VGA_DISPLAY_13H;
+    vga_init_buffers();
+    vga_clear_screen();
+    vga_present();
+}
+
+void vga_init_buffers() {
+    if (back_buffer == nullptr) {
+        back_buffer = new unsigned char[VGA_WIDTH * VGA_HEIGHT];
+        front_buffer = new unsigned char[VGA_WIDTH * VGA_HEIGHT];
+        Raster::init();
+        Palette::init();
     }
 }
 
+void vga_init_text() {
+    text_init();
+    vga_init_buffers();
+    vga_clear_screen();
+    display = VGA_DISPLAY_TEXT;
+}
+
+void vga_init_12h() {
+    vga12_init();
+    vga_init_buffers();
+    vga_clear_screen();
+    display = VGA_DISPLAY_12H;
+}
+
+void vga_init_modex() {
+    modex_init();
+    vga_init_buffers();
+    vga_clear_screen();
+    display = VGA_DISPLAY_MODEX;
+}
+
+VgaDisplay vga_display() {
+    return display;
+}
+
+bool vga_text_mode() {
+    return display == VGA_DISPLAY_TEXT;
+}
+
+void vga_wait_retrace() {
+    // bit 3 of input status #1 is set during vertical retrace
+    while ((inb(VGA_INSTAT_READ) & 0x08) != 0) {
+        pause();
+    }
+    while ((inb(VGA_INSTAT_READ) & 0x08) == 0) {
+        pause();
+    }
+}
+
+uint8_t* vga_back_buffer() {
+    return back_buffer;
+}
+
+void vga_clear_screen() {
+    memset32(back_buffer, COLOR_BLACK * 0x01010101, VGA_WIDTH * VGA_HEIGHT / 4);
+}
+
 void vga_plot_pixel(int x, int y, unsigned short color) {
     // Debug::printf("%d", sizeof(unsigned short));
-    unsigned short offset = x + 320 * y;
-    unsigned char *VGA = (unsigned char*) VGA_ADDRESS;
-    VGA[offset] = color;
+    unsigned short offset = x + VGA_WIDTH * y;
+    back_buffer[offset] = color;
+}
+
+void vga_draw_packed(const PackedFrame& frame) {
+    expand_1bpp(frame.bits, back_buffer, PACKED_FRAME_BYTES, B, W);
 }
 
-void draw_image(unsigned short* image, int x, int y, int width, int height, int scale) {
-    for (int cur_height = 0; cur_height < height; cur_height++) {
-        for (int cur_width = 0; cur_width < width; cur_width++) {
-            draw_rectangle(x+cur_width*scale, y+cur_height*scale, scale, scale, image[width*cur_height+cur_width]);
+bool vga_draw_encoded(uint16_t codec, const uint8_t* data, uint32_t size, DecodeStats* stats) {
+    return decode_frame(codec, data, size, back_buffer, B, W, stats);
+}
+
+bool vga_draw_encoded_rows(uint16_t codec, const uint8_t* data, uint32_t size, uint32_t y0, uint32_t y1, DecodeStats* stats) {
+    return decode_frame_rows(codec, data, size, back_buffer, B, W, y0, y1, stats);
+}
+
+void vga_present() {
+    memcpy32((void*) VGA_ADDRESS, back_buffer, VGA_WIDTH * VGA_HEIGHT / 4);
+    memcpy32(front_buffer, back_buffer, VGA_WIDTH * VGA_HEIGHT / 4);
+}
+
+PresentStats vga_show_frame(uint32_t frame) {
+    if (VBE::width() != 0) {
+        // flip() returns as a retrace starts, the DAC can be loaded in that
+        // same retrace instead of waiting for another one
+        VBE::flip();
+        Palette::tick(frame, false);
+        return PresentStats{0, VBE::frame_bytes()};
+    }
+    if (display == VGA_DISPLAY_MODEX) {
+        // like a VBE flip, this returns as the retrace that shows it starts
+        modex_present(back_buffer);
+        Palette::tick(frame, false);
+        return PresentStats{0, VGA_WIDTH * VGA_HEIGHT};
+    }
+    Palette::tick(frame);
+    if (display == VGA_DISPLAY_TEXT) {
+        return text_present(back_buffer);
+    }
+    if (display == VGA_DISPLAY_12H) {
+        vga12_present_pixels(back_buffer);
+        return PresentStats{0, VGA12_ROW_BYTES * 2 * VGA_HEIGHT};
+    }
+    return vga_present_dirty();
+}
+
+PresentStats vga_present_dirty() {
+    constexpr uint32_t WORDS_PER_TILE_ROW = VGA_TILE_SIZE / sizeof(uint32_t);
+    constexpr uint32_t WORDS_PER_ROW = VGA_WIDTH / sizeof(uint32_t);
+
+    PresentStats stats{};
+    auto back = (uint32_t*) back_buffer;
+    auto front = (uint32_t*) front_buffer;
+    auto vga = (volatile uint32_t*) VGA_ADDRESS;
+
+    for (uint32_t ty = 0; ty < VGA_HEIGHT / VGA_TILE_SIZE; ty++) {
+        for (uint32_t tx = 0; tx < VGA_WIDTH / VGA_TILE_SIZE; tx++) {
+            uint32_t first = ty * VGA_TILE_SIZE * WORDS_PER_ROW + tx * WORDS_PER_TILE_ROW;
+
+            // OR together the XOR of every word in the tile, non-zero means
+            // at least one pixel changed
+            uint32_t diff = 0;
+            for (uint32_t row = 0; row < VGA_TILE_SIZE; row++) {
+                uint32_t i = first + row * WORDS_PER_ROW;
+                for (uint32_t w = 0; w < WORDS_PER_TILE_ROW; w++) {
+                    diff |= back[i + w] ^ front[i + w];
+                }
+            }
+            if (diff == 0) continue;
+
+            for (uint32_t row = 0; row < VGA_TILE_SIZE; row++) {
+                uint32_t i = first + row * WORDS_PER_ROW;
+                for (uint32_t w = 0; w < WORDS_PER_TILE_ROW; w++) {
+                    vga[i + w] = back[i + w];
+                    front[i + w] = back[i + w];
+                }
+            }
+            stats.tiles_changed += 1;
+            stats.bytes_written += VGA_TILE_SIZE * VGA_TILE_SIZE;
+        }
+    }
+    return stats;
+}
+
+void draw_image(unsigned char* image, int x, int y, int width, int height, int scale) {
+    auto kernel = blit_kernel(BLIT_8BPP, scale);
+    if (kernel != nullptr) {
+        kernel(image, width, width, height, back_buffer + y * VGA_WIDTH + x, VGA_WIDTH, B, W);
+    } else {
+        for (int cur_height = 0; cur_height < height; cur_height++) {
+            for (int cur_width = 0; cur_width < width; cur_width++) {
+                draw_rectangle(x+cur_width*scale, y+cur_height*scale, scale, scale, image[width*cur_height+cur_width]);
+            }
         }
     }
 
     Debug::printf("*** drew the image\n");
 }
 
-void draw_animation(unsigned short* image, int x, int y, int width, int height, int scale, int num_frames) {
+void draw_animation(unsigned char* image, int x, int y, int width, int height, int scale, int num_frames, int fps) {
+	FramePacer pacer{(uint32_t) fps};
 	for (int cur_frame = 0; cur_frame < num_frames; cur_frame++) {
 		vga_clear_screen();
 		draw_image(image + (cur_frame*width*height), x, y, width, height, scale);
+		if (!pacer.wait(cur_frame)) continue; // too late, drop it
 
-		volatile int i = 0;
-		for (int j = 0; j < 200000000; j++) {i+=1;} // pause between each frame
+		auto stats = vga_present_dirty();
+		Debug::printf("| frame %d: %d tiles changed, %d bytes written\n",
+			cur_frame, stats.tiles_changed, stats.bytes_written);
 	}
 }
 
@@ -150,8 +381,25 @@ void write_regs(unsigned char *regs)
 // End copied code
 
 void vga_test() {
-    write_regs(g_320x200x256);
-	vga_clear_screen();
+    vga_init();
+
+    // hand the video to the video service and return, the caller can
+    // follow it with the video_status system call. Scale it up when the
+    // card can do better than 320x200; the mode is set before the service
+    // starts, so it only ever presents in that mode
+    const bool vbe = VBE::set_mode(640, 480, 8);
+    if (Video::open("/video/bad_apple.vid")) {
+        if (vbe) Debug::printf("| VBE 640x480x8\n");
+        auto status = Video::status();
+        Debug::printf("*** playing %d frames\n", status.n_frames);
+        Video::play();
+        return;
+    }
+    if (vbe) {
+        // no video, the demo below draws in mode 13h
+        VBE::disable();
+        vga_init();
+    }
 
 	// 320x200, scale 20 16x10
 	// 10fps
@@ -166,7 +414,7 @@ void vga_test() {
 
 	// clean up test case dir
 
-    unsigned short frame_1[1200] = {
+    unsigned char frame_1[1200] = {
         B,B,B,B,B,B,B,B,
 		B,B,B,B,B,B,B,W,
 		B,B,B,B,B,B,B,W,
@@ -348,9 +596,5 @@ void vga_test() {
 		W,W,W,B,B,B,W,W,
     };
 
-    draw_animation(frame_1, 0, 0, 8, 5, 40, 30);
-	
-
-    while (true) {
-    }
+    draw_animation(frame_1, 0, 0, 8, 5, 40, 30, 10);
 }
\ No newline at end of file
@@ -1,11 +1,97 @@
 #ifndef __VGA_H
 #define __VGA_H
 
+#include <stdint.h>
+
 #define VGA_ADDRESS 0xA0000
+#define VGA_WIDTH 320
+#define VGA_HEIGHT 200
+
+// side of the square tiles used by vga_present_dirty(), must divide both
+// VGA_WIDTH and VGA_HEIGHT and be a multiple of 4
+#define VGA_TILE_SIZE 8
+
+// palette entries [VGA_GRAY_BASE, VGA_GRAY_BASE + VGA_GRAY_LEVELS) hold a
+// black to white ramp (see palette.h), grayscale frames draw with them
+#define VGA_GRAY_BASE 64
+#define VGA_GRAY_LEVELS 64
+
+struct PackedFrame;
+struct DecodeStats;
+
+struct PresentStats {
+    uint32_t tiles_changed;
+    uint32_t bytes_written;
+};
 
 void vga_test();
+
+// switch to mode 13h and allocate the back buffer
+void vga_init();
+
+// allocate the back buffer (and start the renderer) without touching the
+// display mode, for when a VBE mode owns the screen
+void vga_init_buffers();
+
+// switch to 80x25 text and allocate the back buffer, frames are shown as
+// half blocks (see textmode.h)
+void vga_init_text();
+
+// switch to planar 640x480 mode 12h and allocate the back buffer, frames
+// are shown doubled in black and white (see vga12.h)
+void vga_init_12h();
+
+// switch to unchained 320x240 mode X and allocate the back buffer, frames
+// are page flipped without tearing (see modex.h)
+void vga_init_modex();
+
+// What vga_show_frame() draws on when no VBE mode is set
+enum VgaDisplay : uint8_t {
+    VGA_DISPLAY_NONE = 0,       // nobody picked a mode yet
+    VGA_DISPLAY_13H = 1,
+    VGA_DISPLAY_TEXT = 2,
+    VGA_DISPLAY_12H = 3,
+    VGA_DISPLAY_MODEX = 4,
+};
+
+VgaDisplay vga_display();
+
+// true between vga_init_text() and the next vga_init()
+bool vga_text_mode();
+
+// drawing primitives operate on the back buffer, nothing is visible
+// until vga_present() copies it to VGA memory
 void vga_clear_screen();
 void vga_plot_pixel(int x, int y, unsigned short color);
+void vga_present();
+
+// the VGA_WIDTH x VGA_HEIGHT palette indices drawn so far, for renderers
+// that present it some other way (see modex.h)
+uint8_t* vga_back_buffer();
+
+// block until the next vertical retrace starts
+void vga_wait_retrace();
+
+// expand a packed black and white frame (see frame.h) into the back buffer
+void vga_draw_packed(const PackedFrame& frame);
+
+// decode a frame (see codec.h) into the back buffer, delta frames are
+// applied to the current contents. Returns false if the frame is malformed
+bool vga_draw_encoded(uint16_t codec, const uint8_t* data, uint32_t size, DecodeStats* stats = nullptr);
+
+// same, but only scanlines [y0, y1) are written (see decode_frame_rows)
+bool vga_draw_encoded_rows(uint16_t codec, const uint8_t* data, uint32_t size, uint32_t y0, uint32_t y1, DecodeStats* stats = nullptr);
+
+// like vga_present() but only copies the tiles that differ from what is
+// already on the screen
+PresentStats vga_present_dirty();
+
+// show frame "frame" drawn by the renderer (raster.h): flip the VBE page
+// if a VBE mode is set, otherwise text_present() in text mode,
+// vga12_present_pixels() in mode 12h, modex_present() in mode X and
+// vga_present_dirty() in mode 13h.
+// The palette (palette.h) is brought up to date for it too
+PresentStats vga_show_frame(uint32_t frame);
 
 // Begin copied code
 // Source: https://files.osdev.org/mirrors/geezer/osd/graphics/modes.c
@@ -31,6 +117,9 @@ void vga_plot_pixel(int x, int y, unsigned short color);
 #define	VGA_NUM_SEQ_REGS	5
 
 extern unsigned char g_320x200x256[];
+extern unsigned char g_640x480x16[];
+extern unsigned char g_320x240x256x[];
+extern unsigned char g_80x25_text[];
 void write_regs(unsigned char *regs);
 // end copied code
 
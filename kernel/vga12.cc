@@ -0,0 +1,108 @@
+#include "vga12.h"
+#include "vga.h"
+#include "frame.h"
+#include "machine.h"
+
+namespace {
+
+    // Doubles every bit of a byte: the 8 pixels of a 320 wide frame
+    // become the 16 pixels of a 640 wide row. Stored byte swapped so a
+    // little-endian 16 bit store puts the left half first.
+    struct DoubleTable {
+        uint16_t words[256];
+
+        constexpr DoubleTable() : words{} {
+            for (uint32_t b = 0; b < 256; b++) {
+                uint32_t v = 0;
+                for (uint32_t i = 0; i < 8; i++) {
+                    if (b & (1 << i)) v |= 3 << (2 * i);
+                }
+                words[b] = uint16_t((v >> 8) | ((v & 0xFF) << 8));
+            }
+        }
+    };
+
+    constexpr DoubleTable double_table{};
+
+    static_assert(double_table.words[0x80] == 0x00C0);
+    static_assert(double_table.words[0x01] == 0x0300);
+
+    inline volatile uint8_t* vram() {
+        return (volatile uint8_t*) VGA_ADDRESS;
+    }
+
+    inline void set_map_mask(uint8_t planes) {
+        outb(VGA_SEQ_INDEX, 0x02);
+        outb(VGA_SEQ_DATA, planes);
+    }
+
+    inline void set_gc(uint8_t index, uint8_t value) {
+        outb(VGA_GC_INDEX, index);
+        outb(VGA_GC_DATA, value);
+    }
+
+    constexpr uint32_t TOP = (VGA12_HEIGHT - 2 * VGA_HEIGHT) / 2;
+
+    // a doubled row goes to scanlines 2y and 2y + 1 of the frame
+    inline void put_doubled_row(uint32_t y, const uint16_t* row) {
+        auto dst = (void*) (vram() + (TOP + 2 * y) * VGA12_ROW_BYTES);
+        memcpy32(dst, row, VGA12_ROW_BYTES / 4);
+        memcpy32((uint8_t*) dst + VGA12_ROW_BYTES, row, VGA12_ROW_BYTES / 4);
+    }
+}
+
+void vga12_init() {
+    write_regs(g_640x480x16);
+
+    set_gc(0x00, 0x00);     // set/reset value
+    set_gc(0x01, 0x00);     // disable set/reset, the CPU data is used for all planes
+    set_gc(0x03, 0x00);     // no rotate, replace
+    set_gc(0x05, 0x00);     // write mode 0
+    set_gc(0x08, 0xFF);     // all bits come from the CPU
+    set_map_mask(0x0F);     // latch every write into all 4 planes
+
+    vga12_clear();
+}
+
+void vga12_clear() {
+    memset32((void*) VGA_ADDRESS, 0, VGA12_ROW_BYTES * VGA12_HEIGHT / 4);
+}
+
+void vga12_blit_packed(const uint8_t* rows, uint32_t row_bytes, uint32_t height, uint32_t x_byte, uint32_t y) {
+    for (uint32_t j = 0; j < height; j++) {
+        auto dst = vram() + (y + j) * VGA12_ROW_BYTES + x_byte;
+        auto src = rows + j * row_bytes;
+        for (uint32_t i = 0; i < row_bytes; i++) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+void vga12_present_frame(const PackedFrame& frame) {
+    static_assert(2 * PACKED_ROW_BYTES == VGA12_ROW_BYTES);
+
+    // build each doubled row once in RAM then write it to 2 scanlines
+    uint16_t row[VGA12_ROW_BYTES / 2] __attribute__((aligned(4)));
+    for (uint32_t y = 0; y < VGA_HEIGHT; y++) {
+        auto src = frame.bits + y * PACKED_ROW_BYTES;
+        for (uint32_t i = 0; i < PACKED_ROW_BYTES; i++) {
+            row[i] = double_table.words[src[i]];
+        }
+        put_doubled_row(y, row);
+    }
+}
+
+void vga12_present_pixels(const uint8_t* pixels) {
+    uint16_t row[VGA12_ROW_BYTES / 2] __attribute__((aligned(4)));
+    for (uint32_t y = 0; y < VGA_HEIGHT; y++) {
+        auto src = pixels + y * VGA_WIDTH;
+        for (uint32_t i = 0; i < PACKED_ROW_BYTES; i++) {
+            uint32_t bits = 0;
+            for (uint32_t b = 0; b < 8; b++) {
+                bits = (bits << 1) | (src[8 * i + b] != 0);
+            }
+            row[i] = double_table.words[bits];
+        }
+        put_doubled_row(y, row);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+struct PackedFrame;
+
+// Planar mode 12h (640x480, 16 colors) renderer for black and white video.
+//
+// In mode 12h every pixel is one bit in each of the 4 planes, so a packed
+// 1bpp row is already in the format the card wants. With write mode 0, no
+// set/reset, a full bit mask and all planes enabled in the sequencer map
+// mask, each byte the CPU writes is latched into all 4 planes at once:
+// 0 bits become color 0 (black) and 1 bits become color 15 (white). A row
+// of 8 pixels costs a single byte in the VGA aperture instead of the 8 it
+// would cost in mode 13h.
+
+#define VGA12_WIDTH 640
+#define VGA12_HEIGHT 480
+#define VGA12_ROW_BYTES (VGA12_WIDTH / 8)
+
+// switch to mode 12h, set up the graphics controller and clear the screen
+void vga12_init();
+
+// clear all 4 planes
+void vga12_clear();
+
+// Copy "height" packed rows of "row_bytes" bytes each (most significant
+// bit is the leftmost pixel) to the screen, with the top left corner at
+// pixel (8 * x_byte, y). No clipping.
+void vga12_blit_packed(const uint8_t* rows, uint32_t row_bytes, uint32_t height, uint32_t x_byte, uint32_t y);
+
+// Show a 320x200 frame scaled 2x to 640x400, centered vertically
+void vga12_present_frame(const PackedFrame& frame);
+
+// Same for a VGA_WIDTH x VGA_HEIGHT buffer of palette indices (the
+// renderer's back buffer): index 0 is black, anything else white
+void vga12_present_pixels(const uint8_t* pixels);
@@ -0,0 +1,201 @@
+#include "video.h"
+#include "player.h"
+#include "pacer.h"
+#include "vga.h"
+#include "vbe.h"
+#include "codec.h"
+#include "threads.h"
+#include "semaphore.h"
+#include "atomic.h"
+#include "libk.h"
+#include "frame_stats.h"
+#include "headless.h"
+#include "palette.h"
+
+namespace Video {
+
+    constexpr uint32_t NO_SEEK = 0xFFFFFFFF;
+
+    // Requests waiting for the service
+    struct Requests {
+        StrongPtr<Player> open;
+        uint32_t seek;
+        bool change_state;
+        bool play;
+    };
+
+    static SpinLock* spin = nullptr;        // protects "requests" and "current"
+    static Requests* requests = nullptr;
+    static Status* current = nullptr;
+    static Semaphore* wake = nullptr;       // upped on every request
+
+    static Atomic<bool> claimed{false};     // someone is starting the service
+    static Atomic<bool> ready{false};       // ... and it is done
+
+    static void service();
+
+    // start the service thread the first time anyone asks for it
+    static void start() {
+        if (ready.get()) return;
+        if (claimed.exchange(true)) {
+            while (!ready.get()) ::pause();
+            return;
+        }
+        spin = new SpinLock();
+        requests = new Requests();
+        requests->seek = NO_SEEK;
+        current = new Status{};
+        wake = new Semaphore(0);
+
+        // The service owns the display from now on. Set it up here, in the
+        // caller, so it is done before open() returns and can't race with
+        // a mode the caller sets next
+        if (VBE::width() == 0 && vga_display() == VGA_DISPLAY_NONE) {
+            vga_init();
+        } else {
+            vga_init_buffers();
+        }
+        ready.set(true);
+        thread([] {
+            service();
+        });
+    }
+
+    static void publish(Status const& status) {
+        spin->lock();
+        *current = status;
+        spin->unlock();
+    }
+
+    static void service() {
+        StrongPtr<Player> player{};
+        FramePacer* pacer = nullptr;
+        Status status{};
+        bool playing = false;
+        uint32_t next = 0;          // the frame the player decodes next
+        uint32_t draw_from = 0;     // the first frame of this run of the pacer
+        DecodeStats decoded{};
+
+        while (true) {
+            spin->lock();
+            auto req = *requests;
+            requests->open = {};
+            requests->seek = NO_SEEK;
+            requests->change_state = false;
+            spin->unlock();
+
+            if (!(req.open == nullptr)) {
+                player = req.open;
+                if (pacer != nullptr) delete pacer;
+                pacer = new FramePacer(player->fps());
+                status = Status{PAUSED, 0, player->n_frames(), 0, 0, 0, 0};
+                playing = false;
+                next = player->start(0);
+                draw_from = 0;
+                Palette::fade_in(0, player->fps() / 2);
+                FrameStats::begin();
+                if (Headless::enabled()) Headless::begin();
+            }
+
+            if (!(player == nullptr)) {
+                if (req.seek != NO_SEEK && req.seek < player->n_frames()) {
+                    next = player->start(req.seek);
+                    draw_from = req.seek;
+                    pacer->reset();
+                    Palette::fade_in(req.seek, player->fps() / 4);
+                    if (status.state == ENDED) status.state = PAUSED;
+                }
+                if (req.change_state && req.play != playing) {
+                    // resuming: the clock starts over at the next frame
+                    draw_from = K::max(draw_from, next);
+                    playing = req.play;
+                }
+                if (status.state != ENDED) {
+                    status.state = playing ? PLAYING : PAUSED;
+                }
+                status.buffered = player->buffered();
+            }
+            publish(status);
+
+            if (status.state != PLAYING) {
+                wake->down();
+                continue;
+            }
+
+            uint32_t frame;
+            if (!player->step(draw_from, frame, &decoded)) {
+                // report before publishing, whoever waits for the end
+                // (init) prints its own line and shuts down right after
+                player->report_throughput();
+                FrameStats::summary();
+                if (Headless::enabled()) Headless::end();
+                status.state = ENDED;
+                playing = false;
+                publish(status);
+                continue;
+            }
+            next = frame + 1;
+            if (frame < draw_from) continue;    // catching up to a seek
+            if (frame == draw_from) pacer->reset();
+
+            player->present(*pacer, frame, frame - draw_from);
+            status.frame = frame;
+            status.presented = pacer->presented;
+            status.late = pacer->late;
+            status.dropped = pacer->dropped;
+        }
+    }
+
+    // record a request and wake the service
+    template <typename F>
+    static void request(F const& fill) {
+        start();
+        spin->lock();
+        fill(*requests);
+        spin->unlock();
+        wake->up();
+    }
+
+    bool open(const char* path) {
+        auto player = Player::open(path);
+        if (player == nullptr) return false;
+        start();
+
+        StrongPtr<Player> replaced{};   // dropped after the lock is released
+        spin->lock();
+        replaced = requests->open;
+        requests->open = player;
+        *current = Status{PAUSED, 0, player->n_frames(), 0, 0, 0, 0};
+        spin->unlock();
+        wake->up();
+        return true;
+    }
+
+    void play() {
+        request([](Requests& r) {
+            r.change_state = true;
+            r.play = true;
+        });
+    }
+
+    void pause() {
+        request([](Requests& r) {
+            r.change_state = true;
+            r.play = false;
+        });
+    }
+
+    void seek(uint32_t frame) {
+        request([frame](Requests& r) {
+            r.seek = frame;
+        });
+    }
+
+    Status status() {
+        start();
+        spin->lock();
+        auto out = *current;
+        spin->unlock();
+        return out;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+// The video service: one kernel thread that owns the display and plays a
+// stream (see player.h) on behalf of user programs.
+//
+// Every control call only records the request and wakes the service, so
+// none of them block on disk or on the frame clock; the caller finds out
+// what happened through status(). Requests that arrive together are
+// applied in the order open, seek, play/pause.
+namespace Video {
+
+    enum State : uint32_t {
+        IDLE = 0,       // no stream open
+        PAUSED = 1,
+        PLAYING = 2,
+        ENDED = 3,      // played past the last frame
+    };
+
+    // What status() reports, also the layout user space sees
+    struct Status {
+        uint32_t state;
+        uint32_t frame;         // last frame presented (or decoded while paused)
+        uint32_t n_frames;
+        uint32_t presented;     // since the stream was opened
+        uint32_t late;
+        uint32_t dropped;
+        uint32_t buffered;      // encoded frames read ahead of the decoder
+    };
+
+    // Open a stream (replacing the current one), it starts PAUSED at
+    // frame 0. Only reads the header and the keyframe index, returns false
+    // if "path" is not a video
+    extern bool open(const char* path);
+
+    extern void play();
+    extern void pause();
+
+    // Continue from "frame" (playing or paused, as before)
+    extern void seek(uint32_t frame);
+
+    extern Status status();
+}
@@ -13,6 +13,8 @@ template void VME<NoLock>::insert_free_space(uint32_t, uint32_t);
 template StrongPtr<VMEEntry> VME<NoLock>::get(uint32_t);
 template uint32_t VME<NoLock>::add_entry(uint32_t, StrongPtr<Node>, uint32_t, bool);
 template void VME<NoLock>::remove_entry(uint32_t, bool);
+template uint32_t VME<NoLock>::add_device_entry(uint32_t, uint32_t, bool);
+template StrongPtr<VMEEntry> VME<NoLock>::device_entry();
 // template StrongPtr<VME<NoLock>> VME<NoLock>::duplicate(StrongPtr<VME<NoLock>>);
 
 template void VME<BlockingLock>::insert_entry_sorted(uint32_t, uint32_t, uint32_t, StrongPtr<Node>, uint32_t, bool);
@@ -21,12 +23,15 @@ template void VME<BlockingLock>::insert_free_space(uint32_t, uint32_t);
 template StrongPtr<VMEEntry> VME<BlockingLock>::get(uint32_t);
 template uint32_t VME<BlockingLock>::add_entry(uint32_t, StrongPtr<Node>, uint32_t, bool);
 template void VME<BlockingLock>::remove_entry(uint32_t, bool);
+template uint32_t VME<BlockingLock>::add_device_entry(uint32_t, uint32_t, bool);
+template StrongPtr<VMEEntry> VME<BlockingLock>::device_entry();
 // template StrongPtr<VME<BlockingLock>> VME<BlockingLock>::duplicate(StrongPtr<VME<BlockingLock>>);
 
 VMEEntry::VMEEntry(uint32_t start, uint32_t num_pages, uint32_t size, StrongPtr<Node> file, uint32_t file_offset, bool user): start(start), num_pages(num_pages), size(size), file(file), file_offset(file_offset), user(user) {};
 VMEEntry::~VMEEntry(){
     for(uint32_t i = 0; i < num_pages; i++) {
-        VMM::remove_mapping((uint32_t*)getCR3(), ((uint32_t)start + i * PhysMem::FRAME_SIZE) >> 12);
+        // device pages are not ours to free
+        VMM::remove_mapping((uint32_t*)getCR3(), ((uint32_t)start + i * PhysMem::FRAME_SIZE) >> 12, phys == 0);
     }
 };
 
@@ -153,6 +158,26 @@ uint32_t VME<Lock>::add_entry(uint32_t size, StrongPtr<Node> file, uint32_t file
     return va;
 }
 
+// Like add_entry but the pages are the physical range starting at "phys"
+// (page aligned) instead of fresh frames, vmm_pageFault maps them on demand
+template <typename Lock>
+uint32_t VME<Lock>::add_device_entry(uint32_t size, uint32_t phys, bool user) {
+    uint32_t va = add_entry(size, StrongPtr<Node>{}, 0, user);
+    if (va != 0) {
+        get(va)->phys = phys;
+    }
+    return va;
+}
+
+// The first entry backed by device memory, nullptr if there is none
+template <typename Lock>
+StrongPtr<VMEEntry> VME<Lock>::device_entry() {
+    LockGuard g{lock};
+    for (auto curr = entries; !(curr == nullptr); curr = curr->next) {
+        if (curr->phys != 0) return curr;
+    }
+    return {};
+}
 
 template <typename Lock>
 void VME<Lock>::remove_entry(uint32_t va, bool user) {
@@ -201,6 +226,7 @@ StrongPtr<VMEEntry> VMEEntry::duplicate(StrongPtr<VMEEntry> vme_entry) {
     // Debug::printf("HERE\n");
     // Debug::printf("START: %x | NUM_PAGES: %d | SIZE: %d | FILE: %d | OFFSET: %d\n", vme_entry->start, vme_entry->num_pages, vme_entry->size, vme_entry->file, vme_entry->file_offset);
     StrongPtr<VMEEntry> new_vme_entry = StrongPtr<VMEEntry>::make(vme_entry->start, vme_entry->num_pages, vme_entry->size, vme_entry->file, vme_entry->file_offset, vme_entry->user);
+    new_vme_entry->phys = vme_entry->phys;
     // Debug::printf("AFTER CREATION\n");
     new_vme_entry->next = VMEEntry::duplicate(vme_entry->next);
     return new_vme_entry;
@@ -15,6 +15,7 @@ struct VMEEntry {
     uint32_t file_offset;
     StrongPtr<VMEEntry> next{nullptr};
     bool user;
+    uint32_t phys = 0;      // device memory (e.g. a framebuffer) backing the entry, 0 if none
     
     VMEEntry(uint32_t start, uint32_t num_pages, uint32_t size, StrongPtr<Node> file, uint32_t file_offset, bool user);
     ~VMEEntry();
@@ -53,6 +54,8 @@ class VME {
 
     StrongPtr<VMEEntry> get(uint32_t va);
     uint32_t add_entry(uint32_t size, StrongPtr<Node> file, uint32_t file_offset, bool user);
+    uint32_t add_device_entry(uint32_t size, uint32_t phys, bool user);
+    StrongPtr<VMEEntry> device_entry();
     void remove_entry(uint32_t va, bool user);
 
     static StrongPtr<VME> duplicate(StrongPtr<VME> vme);
@@ -8,6 +8,7 @@
 #include "debug.h"
 #include "ext2.h"
 #include "sys.h"
+#include "vbe.h"
 
 
 namespace VMM {
@@ -88,7 +89,7 @@ void add_mapping(uint32_t* PD, uint32_t VPN, uint32_t PPN, bool global, bool wri
     invlpg(VPN << 12);
 }
 
-void remove_mapping(uint32_t* PD, uint32_t VPN) {
+void remove_mapping(uint32_t* PD, uint32_t VPN, bool free_frame) {
     ASSERT(PD != nullptr);
     uint32_t PDI = VPN >> 10;
     uint32_t PTI = VPN & (0x3FF);
@@ -103,7 +104,7 @@ void remove_mapping(uint32_t* PD, uint32_t VPN) {
         return;
     }
     
-    if(PT[PTI] & 0x1) {
+    if((PT[PTI] & 0x1) && free_frame) {
         PhysMem::dealloc_frame(PT[PTI] & ~0xFFF);
     }
 
@@ -114,6 +115,12 @@ void remove_mapping(uint32_t* PD, uint32_t VPN) {
 
 uint32_t global_page_directory;
 
+// false for the VGA aperture, the LFB and anything else that isn't a frame
+// PhysMem hands out
+static bool is_ram(uint32_t pa) {
+    return pa < kConfig.memSize && !(pa >= 0xA0000 && pa < 0x100000);
+}
+
 uint32_t new_page_directory() {
     // Debug::printf("CREATING A NEW PD\n");
     uint32_t tmp = PhysMem::alloc_frame();
@@ -130,7 +137,9 @@ void copy_page_directory(uint32_t* pd, uint32_t* new_pd) {
             new_pd[i] = pd[i] & 0xFFF; // copy metadata
             new_pd[i] |= (uint32_t)new_pt; // assign new PT
             for(uint32_t y = 0; y < 1024; y++) {
-                if(pt[y] & 0x1) {
+                if((pt[y] & 0x1) && !is_ram(pt[y] & ~0xFFF)) {
+                    new_pt[y] = pt[y]; // device memory, share it
+                } else if(pt[y] & 0x1) {
                     uint32_t* pa = (uint32_t*)(pt[y] & ~0xFFF);
                     uint32_t* new_pa = (uint32_t*)PhysMem::alloc_frame();
                     new_pt[y] = pt[y] & 0xFFF; // copy metadata
@@ -163,13 +172,42 @@ void global_init() {
 
     add_mapping((uint32_t*)global_page_directory, PhysMem::ppn(kConfig.ioAPIC), PhysMem::ppn(kConfig.ioAPIC), true, false, true);
     add_mapping((uint32_t*)global_page_directory, PhysMem::ppn(kConfig.localAPIC), PhysMem::ppn(kConfig.localAPIC), true, false, true);
+
+    // the HPET page is only used if it sits between the two APIC pages,
+    // the shared region below is laid out around it
+    const uint32_t hpet = kConfig.hpet & ~(PhysMem::FRAME_SIZE - 1);
+    if (hpet > kConfig.ioAPIC && hpet < kConfig.localAPIC) {
+        add_mapping((uint32_t*)global_page_directory, PhysMem::ppn(hpet), PhysMem::ppn(hpet), true, true, false);
+    } else {
+        kConfig.hpet = 0;
+    }
     
     shared_vme_lock = new BlockingLock();
     shared_vme = new VME<BlockingLock>(kConfig.localAPIC + PhysMem::FRAME_SIZE, 0xFFFFFFFF);
 
-    shared_vme->insert_free_space(0xF0000000, (kConfig.ioAPIC - 0xF0000000) / PhysMem::FRAME_SIZE);
+    // The VBE linear framebuffer sits at the bottom of the shared region,
+    // mapped up front so every address space sees it
+    uint32_t shared_free = 0xF0000000;
+    uint32_t lfb = VBE::lfb_physical();
+    if (lfb != 0) {
+        const uint32_t lfb_pages = VBE::LFB_BYTES / PhysMem::FRAME_SIZE;
+        for (uint32_t i = 0; i < lfb_pages; i++) {
+            add_mapping((uint32_t*)global_page_directory, PhysMem::ppn(VBE::LFB_VA) + i, PhysMem::ppn(lfb) + i, true, true, false);
+        }
+        shared_vme->insert_entry_sorted(VBE::LFB_VA, lfb_pages, VBE::LFB_BYTES, StrongPtr<Node>{}, 0, false);
+        shared_free = VBE::LFB_VA + VBE::LFB_BYTES;
+        VBE::set_mapped();
+    }
+
+    shared_vme->insert_free_space(shared_free, (kConfig.ioAPIC - shared_free) / PhysMem::FRAME_SIZE);
     shared_vme->insert_entry_sorted(kConfig.ioAPIC, 1, PhysMem::FRAME_SIZE, StrongPtr<Node>{}, 0, false);
-    shared_vme->insert_free_space(kConfig.ioAPIC + PhysMem::FRAME_SIZE, (kConfig.localAPIC - (kConfig.ioAPIC + PhysMem::FRAME_SIZE)) / PhysMem::FRAME_SIZE);
+    if (kConfig.hpet != 0) {
+        shared_vme->insert_free_space(kConfig.ioAPIC + PhysMem::FRAME_SIZE, (hpet - (kConfig.ioAPIC + PhysMem::FRAME_SIZE)) / PhysMem::FRAME_SIZE);
+        shared_vme->insert_entry_sorted(hpet, 1, PhysMem::FRAME_SIZE, StrongPtr<Node>{}, 0, false);
+        shared_vme->insert_free_space(hpet + PhysMem::FRAME_SIZE, (kConfig.localAPIC - (hpet + PhysMem::FRAME_SIZE)) / PhysMem::FRAME_SIZE);
+    } else {
+        shared_vme->insert_free_space(kConfig.ioAPIC + PhysMem::FRAME_SIZE, (kConfig.localAPIC - (kConfig.ioAPIC + PhysMem::FRAME_SIZE)) / PhysMem::FRAME_SIZE);
+    }
     shared_vme->insert_entry_sorted(kConfig.localAPIC, 1, PhysMem::FRAME_SIZE, StrongPtr<Node>{}, 0, false);
     // // Shared
     // for(uint32_t i = 0; i < num_shared_pages; i++) {
@@ -226,6 +264,13 @@ extern "C" void vmm_pageFault(uintptr_t va_, uintptr_t *saveState) {
         Debug::printf("VME ENTRY IS NULL\n");
         exit(-1);
     }
+
+    if(vme_entry->phys != 0) { // device memory, map the page that backs it
+        uint32_t page_offset = (va_ & ~0xFFF) - vme_entry->start;
+        VMM::add_mapping((uint32_t*)(getCR3()), (va_ >> 12), (vme_entry->phys + page_offset) >> 12, false, true, vme_entry->user);
+        if(unlock) VMM::shared_vme_lock->unlock();
+        return;
+    }
     
     uint32_t new_page = PhysMem::alloc_frame();
     
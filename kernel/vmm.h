@@ -15,7 +15,8 @@ namespace VMM {
     extern VME<BlockingLock>* shared_vme;
 
     extern void remove_PT_mapping(uint32_t* PD, uint32_t PDI);
-    extern void remove_mapping(uint32_t* PD, uint32_t VPN);
+    // "free_frame" is false for device memory, the PTE is just cleared
+    extern void remove_mapping(uint32_t* PD, uint32_t VPN, bool free_frame = true);
 
     extern uint32_t new_page_directory();
     extern void copy_page_directory(uint32_t* pd, uint32_t* new_pd);
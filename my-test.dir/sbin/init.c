@@ -8,7 +8,22 @@ void one(int fd) {
 }
 
 int main(int argc, char** argv) {
-    vga();
+    if (video_open("/video/bad_apple.vid") == 0) {
+        struct video_status status;
+        /* a few polls per second is plenty, playback doesn't need us */
+        const struct timespec poll = { 0, 100000000 };
+        video_play();
+        /* the kernel plays it, we only check on it */
+        do {
+            nanosleep(&poll);
+            video_status(&status);
+        } while (status.state != VIDEO_ENDED);
+        printf("*** presented %d of %d frames, dropped %d\n",
+            (int) status.presented, (int) status.n_frames, (int) status.dropped);
+    } else {
+        /* no video, run the kernel demo instead */
+        vga();
+    }
     shutdown();
     return 0;
 }
@@ -80,4 +80,106 @@ extern int execl(const char* path, const char* arg0, ...);
 
 extern int vga();
 
+/* nanosleep */
+/* sleeps for at least "t", rounded up to the 1 ms timer tick */
+/* return 0 on success, -ve value if "t" is invalid */
+struct timespec {
+    uint32_t tv_sec;
+    uint32_t tv_nsec;       /* less than 1000000000 */
+};
+
+extern int nanosleep(const struct timespec* t);
+
+/* clock_gettime */
+/* the time since boot, with microsecond resolution */
+/* return 0 on success, -ve value on failure */
+extern int clock_gettime(struct timespec* t);
+
+/* scheduler */
+
+/* sched_quantum */
+/* how many jiffies (ms) a thread runs before others get the core, */
+/* from 1 to 1000, anything else is rejected */
+extern int sched_quantum(uint32_t jiffies);
+
+struct sched_stats {
+    uint32_t quantum;
+    uint32_t voluntary;     /* switches because a thread blocked */
+    uint32_t involuntary;   /* switches because a slice ran out */
+};
+
+/* sched_stats */
+/* return 0 on success, -ve value on failure */
+extern int sched_stats(struct sched_stats* stats);
+
+/* framebuffer */
+
+struct vga_mode {
+    uint32_t width;
+    uint32_t height;
+    uint32_t bpp;
+    uint32_t pitch;     /* bytes per row */
+    uint32_t pages;     /* pages in the mapping, see vga_present */
+};
+
+/* vga_setmode */
+/* 320x200x8 is VGA mode 13h, 80x25x0 is text mode (vga_map gives */
+/* 16 bit cells, a character and an attribute byte), 640x480x4 is */
+/* planar mode 12h (vga_map gives 1 bit per pixel, most significant */
+/* bit leftmost, 0 black and 1 white), 320x240x8 is mode X (only */
+/* the kernel video service draws in it, vga_map fails), anything */
+/* else is a VBE mode */
+/* return 0 on success, -ve value on failure */
+extern int vga_setmode(uint32_t width, uint32_t height, uint32_t bpp);
+
+/* vga_map */
+/* maps the framebuffer of the current mode and describes it in "mode" */
+/* returns 0 on failure. Calling it again in the same mode returns the */
+/* same mapping; after a mode change the old mapping is gone. A mapping */
+/* lasts until exit or execl otherwise */
+extern void* vga_map(struct vga_mode* mode);
+
+/* vga_present */
+/* shows what was drawn since the last call, returns the byte offset */
+/* (from the vga_map address) of the page to draw the next frame into */
+extern uint32_t vga_present(void);
+
+/* video service */
+/* the kernel plays the video in its own thread, none of these block */
+
+#define VIDEO_IDLE 0        /* nothing open */
+#define VIDEO_PAUSED 1
+#define VIDEO_PLAYING 2
+#define VIDEO_ENDED 3
+
+struct video_status {
+    uint32_t state;
+    uint32_t frame;         /* last frame shown */
+    uint32_t n_frames;
+    uint32_t presented;
+    uint32_t late;
+    uint32_t dropped;
+    uint32_t buffered;      /* frames read ahead */
+};
+
+/* video_open */
+/* replaces the current video, it starts paused at frame 0 */
+/* return 0 on success, -ve value if "path" is not a video */
+extern int video_open(const char* path);
+
+extern int video_play(void);
+extern int video_pause(void);
+
+/* video_seek */
+/* continue from "frame", playing or paused as before */
+extern int video_seek(uint32_t frame);
+
+/* video_status */
+/* return 0 on success, -ve value on failure */
+extern int video_status(struct video_status* status);
+
+/* video_dither */
+/* grayscale videos are shown with 16 dithered levels instead of 64 */
+extern int video_dither(int on);
+
 #endif
@@ -0,0 +1,267 @@
+#include "libc.h"
+
+/*
+ * User space video player.
+ *
+ * Maps the framebuffer once then decodes every frame (see kernel/codec.h
+ * for the formats) and scales it straight into the page we are allowed
+ * to draw into. The only system calls per frame are the reads of the
+ * frame, one vga_present and, when we are early, one nanosleep to hold
+ * the video to its own frame rate rather than the display's.
+ */
+
+#define WIDTH 320
+#define HEIGHT 200
+#define ROW_BYTES (WIDTH / 8)
+#define PACKED_BYTES (WIDTH * HEIGHT / 8)
+#define MAX_PAYLOAD (WIDTH * HEIGHT)
+
+#define BLACK 0x0
+#define WHITE 0x7
+#define GRAY_BASE 64        /* the kernel loads a 64 level gray ramp here */
+
+#define MAGIC 0x41444142
+
+#define CODEC_RAW 0
+#define CODEC_RLE_KEY 1
+#define CODEC_RLE_DELTA 2
+#define CODEC_QUADTREE 3
+#define CODEC_GRAY_RAW 4
+
+struct header {
+    uint32_t magic;
+    uint32_t n_frames;
+    uint32_t fps;
+    uint32_t frames_offset;
+    uint32_t n_keyframes;
+    uint32_t index_offset;
+};
+
+struct record {
+    uint16_t codec;
+    uint16_t reserved;
+    uint32_t size;
+};
+
+static uint8_t frame[WIDTH * HEIGHT];
+static uint8_t payload[MAX_PAYLOAD];
+
+/* LEB128 run lengths */
+struct runs {
+    const uint8_t* p;
+    const uint8_t* end;
+    int ok;
+};
+
+static uint32_t next_run(struct runs* in) {
+    uint32_t v = 0;
+    uint32_t shift = 0;
+    while (1) {
+        if (in->p == in->end || shift > 28) {
+            in->ok = 0;
+            return 0;
+        }
+        uint8_t b = *in->p++;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) return v;
+        shift += 7;
+    }
+}
+
+static void fill(uint8_t* p, uint32_t n, uint8_t color) {
+    memset(p, color, n);
+}
+
+static int decode_rle_key(struct runs* in) {
+    for (uint32_t y = 0; y < HEIGHT; y++) {
+        uint8_t* row = frame + y * WIDTH;
+        uint32_t x = 0;
+        int white = 0;
+        while (x < WIDTH) {
+            uint32_t n = next_run(in);
+            if (!in->ok || n > WIDTH - x) return 0;
+            fill(row + x, n, white ? WHITE : BLACK);
+            x += n;
+            white = !white;
+        }
+    }
+    return 1;
+}
+
+static int decode_rle_delta(struct runs* in) {
+    uint32_t i = 0;
+    int flipped = 0;
+    while (i < WIDTH * HEIGHT) {
+        uint32_t n = next_run(in);
+        if (!in->ok || n > WIDTH * HEIGHT - i) return 0;
+        if (flipped) {
+            for (uint32_t j = 0; j < n; j++) frame[i + j] ^= BLACK ^ WHITE;
+        }
+        i += n;
+        flipped = !flipped;
+    }
+    return 1;
+}
+
+/* 2 bit quadtree codes, most significant bits first */
+struct nodes {
+    const uint8_t* data;
+    uint32_t size;
+    uint32_t bit;
+    int ok;
+};
+
+static int decode_quad(struct nodes* in, uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    if (in->bit + 2 > in->size * 8) return 0;
+    uint32_t code = (in->data[in->bit / 8] >> (6 - in->bit % 8)) & 3;
+    in->bit += 2;
+
+    if (code == 0 || code == 1) {
+        for (uint32_t j = 0; j < h; j++) {
+            fill(frame + (y + j) * WIDTH + x, w, code ? WHITE : BLACK);
+        }
+        return 1;
+    }
+    if (code != 2 || (w == 1 && h == 1)) return 0;
+
+    uint32_t w0 = w / 2;
+    uint32_t h0 = h / 2;
+    if (h0 != 0) {
+        if (w0 != 0 && !decode_quad(in, x, y, w0, h0)) return 0;
+        if (!decode_quad(in, x + w0, y, w - w0, h0)) return 0;
+    }
+    if (w0 != 0 && !decode_quad(in, x, y + h0, w0, h - h0)) return 0;
+    return decode_quad(in, x + w0, y + h0, w - w0, h - h0);
+}
+
+static int decode(uint16_t codec, uint32_t size) {
+    struct runs runs = { payload, payload + size, 1 };
+    struct nodes nodes = { payload, size, 0, 1 };
+
+    switch (codec) {
+    case CODEC_RAW:
+        if (size != PACKED_BYTES) return 0;
+        for (uint32_t i = 0; i < WIDTH * HEIGHT; i++) {
+            frame[i] = (payload[i / 8] & (0x80 >> (i % 8))) ? WHITE : BLACK;
+        }
+        return 1;
+    case CODEC_RLE_KEY:
+        return decode_rle_key(&runs) && runs.p == runs.end;
+    case CODEC_RLE_DELTA:
+        return decode_rle_delta(&runs) && runs.p == runs.end;
+    case CODEC_QUADTREE:
+        return decode_quad(&nodes, 0, 0, WIDTH, HEIGHT) && (nodes.bit + 7) / 8 == size;
+    case CODEC_GRAY_RAW:
+        if (size != WIDTH * HEIGHT) return 0;
+        for (uint32_t i = 0; i < WIDTH * HEIGHT; i++) {
+            frame[i] = GRAY_BASE + payload[i] / 4;
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* scale the frame by the largest factor that fits, centered */
+static void draw(uint8_t* page, struct vga_mode* mode) {
+    uint32_t scale = mode->width / WIDTH;
+    if (mode->height / HEIGHT < scale) scale = mode->height / HEIGHT;
+    uint32_t left = (mode->width - WIDTH * scale) / 2;
+    uint32_t top = (mode->height - HEIGHT * scale) / 2;
+
+    for (uint32_t y = 0; y < HEIGHT; y++) {
+        uint8_t* row = page + (top + y * scale) * mode->pitch + left;
+        const uint8_t* src = frame + y * WIDTH;
+        for (uint32_t x = 0; x < WIDTH; x++) {
+            fill(row + x * scale, scale, src[x]);
+        }
+        for (uint32_t j = 1; j < scale; j++) {
+            memcpy(row + j * mode->pitch, row, WIDTH * scale);
+        }
+    }
+}
+
+/* sleep until frame i is due, counted from start at fps frames per second */
+static void wait_for_frame(const struct timespec* start, uint32_t fps, uint32_t i) {
+    if (fps == 0) return;
+
+    /* 32 bit arithmetic only, there is no 64 bit division in user space */
+    struct timespec due;
+    due.tv_sec = start->tv_sec + i / fps;
+    due.tv_nsec = start->tv_nsec + (i % fps) * (1000000000 / fps);
+    if (due.tv_nsec >= 1000000000) {
+        due.tv_sec++;
+        due.tv_nsec -= 1000000000;
+    }
+
+    struct timespec now;
+    if (clock_gettime(&now) < 0) return;
+    if (now.tv_sec > due.tv_sec || (now.tv_sec == due.tv_sec && now.tv_nsec >= due.tv_nsec)) return;
+
+    struct timespec left;
+    left.tv_sec = due.tv_sec - now.tv_sec;
+    if (due.tv_nsec >= now.tv_nsec) {
+        left.tv_nsec = due.tv_nsec - now.tv_nsec;
+    } else {
+        left.tv_sec--;
+        left.tv_nsec = due.tv_nsec + 1000000000 - now.tv_nsec;
+    }
+    nanosleep(&left);
+}
+
+int main(int argc, char** argv) {
+    const char* path = (argc > 1) ? argv[1] : "/video/bad_apple.vid";
+
+    int fd = open(path, 0);
+    if (fd < 0) {
+        printf("*** can't open %s\n", path);
+        return 1;
+    }
+
+    struct header header;
+    if (read(fd, &header, sizeof(header)) != sizeof(header) || header.magic != MAGIC) {
+        printf("*** %s is not a video\n", path);
+        return 1;
+    }
+
+    if (vga_setmode(640, 480, 8) < 0 && vga_setmode(WIDTH, HEIGHT, 8) < 0) {
+        printf("*** no usable display mode\n");
+        return 1;
+    }
+
+    struct vga_mode mode;
+    uint8_t* fb = vga_map(&mode);
+    if (fb == 0 || mode.bpp != 8) {
+        printf("*** can't map the framebuffer\n");
+        return 1;
+    }
+    printf("*** playing %d frames at %dx%d\n", (int) header.n_frames, (int) mode.width, (int) mode.height);
+
+    /* with one page we draw on the screen, with two the first hidden one is page 1 */
+    uint32_t offset = (mode.pages > 1) ? mode.pitch * mode.height : 0;
+
+    struct timespec start;
+    if (clock_gettime(&start) < 0) header.fps = 0;
+
+    seek(fd, header.frames_offset);
+    uint32_t shown = 0;
+    for (uint32_t i = 0; i < header.n_frames; i++) {
+        struct record record;
+        if (read(fd, &record, sizeof(record)) != sizeof(record) || record.size > MAX_PAYLOAD ||
+            read(fd, payload, record.size) != (ssize_t) record.size) {
+            printf("*** video truncated at frame %d\n", (int) i);
+            break;
+        }
+        if (!decode(record.codec, record.size)) {
+            printf("*** frame %d is corrupted\n", (int) i);
+            continue;
+        }
+        draw(fb + offset, &mode);
+        wait_for_frame(&start, header.fps, i);
+        offset = vga_present();
+        shown++;
+    }
+
+    printf("*** presented %d frames\n", (int) shown);
+    return 0;
+}